@@ -0,0 +1,72 @@
+#include "blockdata.h"
+#include "bracketindex.h"
+
+int BlockData::changeCount = 0;
+
+const BlockData *BlockData::of(QTextBlock block)
+{
+    const BlockData *data = static_cast<const BlockData *>(block.userData());
+    if (!data || data->revision != block.revision() || data->length != block.length() - 1) {
+        update(block, block.text(), QVector<TokenRun>());
+        data = static_cast<const BlockData *>(block.userData());
+    }
+    return data;
+}
+
+void BlockData::update(QTextBlock block, const QString &text, const QVector<TokenRun> &opaqueSpans)
+{
+    BlockData *data = static_cast<BlockData *>(block.userData());
+    if (!data) {
+        data = new BlockData;
+        block.setUserData(data);
+    }
+
+    const int oldIndent = data->indent;
+    const QVector<Bracket> oldBrackets = std::move(data->brackets);
+    data->revision = block.revision();
+    data->length = text.length();
+    data->indent = indentLevel(text);
+    data->brackets.clear();
+
+    const QChar *chars = text.constData();
+    for (int i = 0; i < text.length(); ++i) {
+        if (!BracketIndex::isBracket(chars[i])) {
+            continue;
+        }
+
+        bool opaque = false;
+        for (const TokenRun &span : opaqueSpans) {
+            if (i >= span.start && i < span.start + span.length) {
+                opaque = true;
+                break;
+            }
+        }
+        if (!opaque) {
+            data->brackets.append({i, chars[i]});
+        }
+    }
+
+    // New blocks come with a new document revision; only changes to known
+    // blocks, such as brackets that highlighting found to be in a comment,
+    // need to be counted
+    if (data->indent != oldIndent || data->brackets != oldBrackets) {
+        ++changeCount;
+    }
+}
+
+int BlockData::indentLevel(const QString &text)
+{
+    int indent = 0;
+    for (QChar c : text) {
+        if (c == ' ') {
+            indent++;
+        } else if (c == '\t') {
+            indent += 4; // Tab counts as 4 spaces
+        } else if (c.isSpace()) {
+            continue;
+        } else {
+            return indent;
+        }
+    }
+    return -1;
+}
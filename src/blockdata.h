@@ -0,0 +1,52 @@
+#ifndef BLOCKDATA_H
+#define BLOCKDATA_H
+
+#include <QString>
+#include <QTextBlock>
+#include <QTextBlockUserData>
+#include <QVector>
+#include "syntaxtokenizer.h"
+
+/**
+ * @brief Facts about one block derived from its text, kept as its user data
+ *
+ * The highlighter refreshes a block's data every time it highlights the
+ * block, when it knows where the strings and comments are. of() refreshes
+ * data whose block changed without being highlighted (or never was) from
+ * the block's own text. Either way a lookup never copies the document and
+ * costs nothing for unchanged blocks.
+ */
+class BlockData : public QTextBlockUserData
+{
+public:
+    struct Bracket {
+        int column;
+        QChar character;
+
+        bool operator==(const Bracket &other) const { return column == other.column && character == other.character; }
+    };
+
+    QVector<Bracket> brackets;  // Outside strings and comments, sorted by column
+    int indent = -1;            // Indentation in columns (tab = 4), -1 for a blank line
+
+    // Data of block, brought up to date with its text if needed
+    static const BlockData *of(QTextBlock block);
+
+    // Recompute the data of block from text, leaving out brackets inside opaqueSpans
+    static void update(QTextBlock block, const QString &text, const QVector<TokenRun> &opaqueSpans);
+
+    // Indentation of a line in columns, -1 if it is blank
+    static int indentLevel(const QString &text);
+
+    // Bumped whenever the brackets or indentation of some block change, so
+    // data derived from many blocks can tell it is out of date
+    static int generation() { return changeCount; }
+
+private:
+    static int changeCount;
+
+    int revision = -1;  // Block revision and length the data was computed for
+    int length = -1;
+};
+
+#endif // BLOCKDATA_H
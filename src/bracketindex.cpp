@@ -0,0 +1,117 @@
+#include "bracketindex.h"
+#include "blockdata.h"
+#include <algorithm>
+
+namespace {
+
+// ( [ { fold; < > is too often an operator
+const int FoldingKinds = 3;
+
+} // namespace
+
+int BracketIndex::bracketKind(QChar c)
+{
+    switch (c.unicode()) {
+        case '(': case ')': return 0;
+        case '[': case ']': return 1;
+        case '{': case '}': return 2;
+        case '<': case '>': return 3;
+        default: return -1;
+    }
+}
+
+bool BracketIndex::isOpeningBracket(QChar c)
+{
+    return c == '(' || c == '[' || c == '{' || c == '<';
+}
+
+int BracketIndex::findMatch(const QTextDocument *document, int position, bool *isCodeBracket)
+{
+    if (isCodeBracket) {
+        *isCodeBracket = false;
+    }
+
+    QTextBlock block = document->findBlock(position);
+    if (!block.isValid()) {
+        return -1;
+    }
+
+    const QVector<BlockData::Bracket> *brackets = &BlockData::of(block)->brackets;
+    const int column = position - block.position();
+    auto it = std::lower_bound(brackets->begin(), brackets->end(), column,
+                               [](const BlockData::Bracket &bracket, int value) { return bracket.column < value; });
+    if (it == brackets->end() || it->column != column) {
+        return -1;
+    }
+    if (isCodeBracket) {
+        *isCodeBracket = true;
+    }
+
+    // Walk the bracket lists block by block; the text itself is never read
+    const int kind = bracketKind(it->character);
+    const bool forward = isOpeningBracket(it->character);
+    int index = int(it - brackets->begin());
+    int depth = 0;
+
+    while (true) {
+        if (forward) {
+            for (; index < brackets->size(); ++index) {
+                const BlockData::Bracket &bracket = brackets->at(index);
+                if (bracketKind(bracket.character) != kind) {
+                    continue;
+                }
+                depth += isOpeningBracket(bracket.character) ? 1 : -1;
+                if (depth == 0) {
+                    return block.position() + bracket.column;
+                }
+            }
+            block = block.next();
+        } else {
+            for (; index >= 0; --index) {
+                const BlockData::Bracket &bracket = brackets->at(index);
+                if (bracketKind(bracket.character) != kind) {
+                    continue;
+                }
+                depth += isOpeningBracket(bracket.character) ? -1 : 1;
+                if (depth == 0) {
+                    return block.position() + bracket.column;
+                }
+            }
+            block = block.previous();
+        }
+
+        if (!block.isValid()) {
+            return -1;
+        }
+        brackets = &BlockData::of(block)->brackets;
+        index = forward ? 0 : int(brackets->size()) - 1;
+    }
+}
+
+int BracketIndex::foldingBracket(QTextBlock block)
+{
+    // Per kind: how many openers are still unclosed and the column of the outermost
+    const QVector<BlockData::Bracket> &brackets = BlockData::of(block)->brackets;
+    int open[FoldingKinds][2] = {};
+    for (const BlockData::Bracket &bracket : brackets) {
+        const int kind = bracketKind(bracket.character);
+        if (kind >= FoldingKinds) {
+            continue;
+        }
+        if (isOpeningBracket(bracket.character)) {
+            if (open[kind][0]++ == 0) {
+                open[kind][1] = bracket.column;
+            }
+        } else if (open[kind][0] > 0) {
+            --open[kind][0];
+        }
+    }
+
+    int column = -1;
+    for (int kind = 0; kind < FoldingKinds; ++kind) {
+        if (open[kind][0] > 0 && (column < 0 || open[kind][1] < column)) {
+            column = open[kind][1];
+        }
+    }
+    return column < 0 ? -1 : block.position() + column;
+}
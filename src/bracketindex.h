@@ -0,0 +1,31 @@
+#ifndef BRACKETINDEX_H
+#define BRACKETINDEX_H
+
+#include <QChar>
+#include <QTextBlock>
+#include <QTextDocument>
+
+/**
+ * @brief Bracket matching over the per-block bracket lists in BlockData
+ *
+ * Only brackets outside strings and comments take part, as far as the
+ * highlighter has seen the block. Brackets match by kind only: ( ), [ ],
+ * { } and < >.
+ */
+class BracketIndex
+{
+public:
+    // 0 to 3 for ( [ { < and their closing brackets, -1 for other characters
+    static int bracketKind(QChar c);
+    static bool isBracket(QChar c) { return bracketKind(c) >= 0; }
+    static bool isOpeningBracket(QChar c);
+
+    // Position of the bracket matching the one at position, or -1. isCodeBracket
+    // (may be null) tells whether position holds a bracket outside strings and comments.
+    static int findMatch(const QTextDocument *document, int position, bool *isCodeBracket = nullptr);
+
+    // Position of the first (, [ or { in block that is not closed within it, or -1
+    static int foldingBracket(QTextBlock block);
+};
+
+#endif // BRACKETINDEX_H
@@ -1,4 +1,7 @@
 #include "codeeditor.h"
+#include "blockdata.h"
+#include "bracketindex.h"
+#include "foldindex.h"
 #include <QPainter>
 #include <QTextBlock>
 #include <QMouseEvent>
@@ -6,9 +9,10 @@
 #include <algorithm>
 
 CodeEditor::CodeEditor(QWidget *parent) : QPlainTextEdit(parent), compactMode(false),
+    visibleFirstBlock(0), visibleLastBlock(0),
     showWrapIndicator(true), showColumnRuler(false), wrapColumn(80),
     autoIndent(true), autoCloseBrackets(true), smartBackspace(true),
-    showIndentationGuides(true), highlightActiveIndent(true)
+    showIndentationGuides(true), highlightActiveIndent(true), foldIndex(document())
 {
     lineNumberArea = new LineNumberArea(this);
 
@@ -56,11 +60,16 @@ int CodeEditor::lineNumberAreaWidth()
 
 void CodeEditor::updateLineNumberAreaWidth(int /* newBlockCount */)
 {
-    setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+    // Called on every full-viewport update while scrolling; relayout only on change
+    const int width = lineNumberAreaWidth();
+    if (viewportMargins().left() != width) {
+        setViewportMargins(width, 0, 0, 0);
+    }
 }
 
 void CodeEditor::updateLineNumberArea(const QRect &rect, int dy)
 {
+    // The gutter is opaque, so scrolling blits it and repaints only the exposed strip
     if (dy)
         lineNumberArea->scroll(0, dy);
     else
@@ -68,6 +77,31 @@ void CodeEditor::updateLineNumberArea(const QRect &rect, int dy)
 
     if (rect.contains(viewport()->rect()))
         updateLineNumberAreaWidth(0);
+
+    updateVisibleBlocks();
+}
+
+void CodeEditor::updateVisibleBlocks()
+{
+    QTextBlock block = firstVisibleBlock();
+    int first = block.blockNumber();
+    int last = first;
+    int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
+    int bottom = viewport()->rect().bottom();
+
+    while (block.isValid() && top <= bottom) {
+        if (block.isVisible()) {
+            last = block.blockNumber();
+        }
+        top += qRound(blockBoundingRect(block).height());
+        block = block.next();
+    }
+
+    if (first != visibleFirstBlock || last != visibleLastBlock) {
+        visibleFirstBlock = first;
+        visibleLastBlock = last;
+        emit visibleBlocksChanged(first, last);
+    }
 }
 
 void CodeEditor::resizeEvent(QResizeEvent *e)
@@ -76,6 +110,7 @@ void CodeEditor::resizeEvent(QResizeEvent *e)
 
     QRect cr = contentsRect();
     lineNumberArea->setGeometry(QRect(cr.left(), cr.top(), lineNumberAreaWidth(), cr.height()));
+    updateVisibleBlocks();
 }
 
 void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
@@ -84,6 +119,12 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
     // Use design spec color for line number area background
     painter.fillRect(event->rect(), QColor(250, 250, 250)); // --color-bg-secondary: #FAFAFA
 
+    // Numbers and icons are blitted from pixmaps rendered once per font and DPR
+    gutterAtlas.prepare(lineNumberArea->font(), lineNumberArea->devicePixelRatioF());
+    const int iconOffset = (fontMetrics().height() - GutterAtlas::IconSize) / 2;
+    const int numberRight = lineNumberArea->width() - 5;
+    const int bookmarkX = lineNumberArea->width() - GutterAtlas::IconSize - 4;
+
     QTextBlock block = firstVisibleBlock();
     int blockNumber = block.blockNumber();
     int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
@@ -91,61 +132,17 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 
     while (block.isValid() && top <= event->rect().bottom()) {
         if (block.isVisible() && bottom >= event->rect().top()) {
-            QString number = QString::number(blockNumber + 1);
-            // Use design spec color for line numbers: --color-fg-secondary: #696D79
-            painter.setPen(QColor(105, 109, 121));
-
             // Draw fold indicator if foldable
-            if (isFoldable(blockNumber)) {
-                int indicatorSize = 8;
-                int indicatorX = 2;
-                int indicatorY = top + (fontMetrics().height() - indicatorSize) / 2;
-
-                painter.save();
-                painter.setRenderHint(QPainter::Antialiasing);
-
-                if (isBlockFolded(blockNumber)) {
-                    // Draw collapsed indicator (right-pointing triangle)
-                    painter.setBrush(QColor(105, 109, 121));
-                    painter.setPen(Qt::NoPen);
-                    QPolygon triangle;
-                    triangle << QPoint(indicatorX, indicatorY)
-                            << QPoint(indicatorX, indicatorY + indicatorSize)
-                            << QPoint(indicatorX + indicatorSize, indicatorY + indicatorSize / 2);
-                    painter.drawPolygon(triangle);
-                } else {
-                    // Draw expanded indicator (down-pointing triangle)
-                    painter.setBrush(QColor(105, 109, 121));
-                    painter.setPen(Qt::NoPen);
-                    QPolygon triangle;
-                    triangle << QPoint(indicatorX, indicatorY)
-                            << QPoint(indicatorX + indicatorSize, indicatorY)
-                            << QPoint(indicatorX + indicatorSize / 2, indicatorY + indicatorSize);
-                    painter.drawPolygon(triangle);
-                }
-
-                painter.restore();
+            if (foldIndex.isFoldable(blockNumber)) {
+                painter.drawPixmap(2, top + iconOffset, gutterAtlas.foldIcon(isBlockFolded(blockNumber)));
             }
 
             // Draw bookmark indicator if bookmarked
             if (bookmarkedLines.contains(blockNumber)) {
-                int indicatorSize = 8;
-                int indicatorX = lineNumberArea->width() - indicatorSize - 4;
-                int indicatorY = top + (fontMetrics().height() - indicatorSize) / 2;
-
-                painter.save();
-                painter.setRenderHint(QPainter::Antialiasing);
-
-                // Draw bookmark as a blue circle
-                painter.setBrush(QColor(66, 135, 245)); // Blue bookmark color
-                painter.setPen(Qt::NoPen);
-                painter.drawEllipse(indicatorX, indicatorY, indicatorSize, indicatorSize);
-
-                painter.restore();
+                painter.drawPixmap(bookmarkX, top + iconOffset, gutterAtlas.bookmarkIcon());
             }
 
-            painter.drawText(12, top, lineNumberArea->width() - 17, fontMetrics().height(),
-                           Qt::AlignRight, number);
+            gutterAtlas.drawNumber(painter, numberRight, top, blockNumber + 1);
         }
 
         block = block.next();
@@ -266,57 +263,6 @@ void CodeEditor::paintEvent(QPaintEvent *event)
     }
 }
 
-bool CodeEditor::isOpeningBracket(QChar c)
-{
-    return c == '(' || c == '[' || c == '{' || c == '<';
-}
-
-bool CodeEditor::isClosingBracket(QChar c)
-{
-    return c == ')' || c == ']' || c == '}' || c == '>';
-}
-
-QChar CodeEditor::getMatchingBracket(QChar c)
-{
-    switch (c.toLatin1()) {
-        case '(': return ')';
-        case ')': return '(';
-        case '[': return ']';
-        case ']': return '[';
-        case '{': return '}';
-        case '}': return '{';
-        case '<': return '>';
-        case '>': return '<';
-        default: return QChar();
-    }
-}
-
-CodeEditor::BracketInfo CodeEditor::findMatchingBracket(QChar bracket, int position, bool forward)
-{
-    QString text = toPlainText();
-    QChar match = getMatchingBracket(bracket);
-    int depth = 1;
-    int step = forward ? 1 : -1;
-    int i = position + step;
-
-    while (i >= 0 && i < text.length()) {
-        QChar current = text[i];
-
-        if (current == bracket) {
-            depth++;
-        } else if (current == match) {
-            depth--;
-            if (depth == 0) {
-                return {match, i};
-            }
-        }
-
-        i += step;
-    }
-
-    return {QChar(), -1}; // No match found
-}
-
 void CodeEditor::matchBrackets()
 {
     QList<QTextEdit::ExtraSelection> extraSelections;
@@ -332,99 +278,51 @@ void CodeEditor::matchBrackets()
         extraSelections.append(selection);
     }
 
-    // Now add bracket matching
+    // Now add bracket matching, looked up in the bracket index
     QTextCursor cursor = textCursor();
     int pos = cursor.position();
-    QString text = toPlainText();
+    QColor matchColor = QColor(68, 130, 180, 60); // Blue with more opacity
 
     // Check character before cursor
+    bool bracketBefore = false;
     if (pos > 0) {
-        QChar charBefore = text[pos - 1];
-        if (isOpeningBracket(charBefore) || isClosingBracket(charBefore)) {
-            bool forward = isOpeningBracket(charBefore);
-            BracketInfo matchInfo = findMatchingBracket(charBefore, pos - 1, forward);
-
-            if (matchInfo.position != -1) {
-                // Matched bracket - highlight both
-                QColor matchColor = QColor(68, 130, 180, 60); // Blue with more opacity
-
-                // Highlight bracket before cursor
-                QTextEdit::ExtraSelection selection1;
-                QTextCursor cursor1 = textCursor();
-                cursor1.setPosition(pos - 1);
-                cursor1.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
-                selection1.cursor = cursor1;
-                selection1.format.setBackground(matchColor);
-                extraSelections.append(selection1);
-
-                // Highlight matching bracket
-                QTextEdit::ExtraSelection selection2;
-                QTextCursor cursor2 = textCursor();
-                cursor2.setPosition(matchInfo.position);
-                cursor2.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
-                selection2.cursor = cursor2;
-                selection2.format.setBackground(matchColor);
-                extraSelections.append(selection2);
-            } else {
-                // Unmatched bracket - highlight in red
-                QColor unmatchedColor = QColor(239, 83, 80, 80); // Red
-
-                QTextEdit::ExtraSelection selection;
-                QTextCursor cursor1 = textCursor();
-                cursor1.setPosition(pos - 1);
-                cursor1.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
-                selection.cursor = cursor1;
-                selection.format.setBackground(unmatchedColor);
-                extraSelections.append(selection);
-            }
+        int match = BracketIndex::findMatch(document(), pos - 1, &bracketBefore);
+
+        if (bracketBefore && match != -1) {
+            // Matched bracket - highlight both
+            extraSelections.append(bracketSelection(pos - 1, matchColor));
+            extraSelections.append(bracketSelection(match, matchColor));
+        } else if (bracketBefore) {
+            // Unmatched bracket - highlight in red
+            QColor unmatchedColor = QColor(239, 83, 80, 80); // Red
+            extraSelections.append(bracketSelection(pos - 1, unmatchedColor));
         }
     }
 
-    // Check character after cursor
-    if (pos < text.length()) {
-        QChar charAfter = text[pos];
-        if (isOpeningBracket(charAfter) || isClosingBracket(charAfter)) {
-            bool forward = isOpeningBracket(charAfter);
-            BracketInfo matchInfo = findMatchingBracket(charAfter, pos, forward);
-
-            if (matchInfo.position != -1) {
-                // Only highlight if we didn't already highlight this pair
-                bool alreadyHighlighted = false;
-                if (pos > 0) {
-                    QChar charBefore = text[pos - 1];
-                    if (isOpeningBracket(charBefore) || isClosingBracket(charBefore)) {
-                        alreadyHighlighted = true;
-                    }
-                }
+    // Check character after cursor, unless the pair before it is already shown
+    if (!bracketBefore) {
+        bool bracketAfter = false;
+        int match = BracketIndex::findMatch(document(), pos, &bracketAfter);
 
-                if (!alreadyHighlighted) {
-                    QColor matchColor = QColor(68, 130, 180, 60);
-
-                    // Highlight bracket after cursor
-                    QTextEdit::ExtraSelection selection1;
-                    QTextCursor cursor1 = textCursor();
-                    cursor1.setPosition(pos);
-                    cursor1.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
-                    selection1.cursor = cursor1;
-                    selection1.format.setBackground(matchColor);
-                    extraSelections.append(selection1);
-
-                    // Highlight matching bracket
-                    QTextEdit::ExtraSelection selection2;
-                    QTextCursor cursor2 = textCursor();
-                    cursor2.setPosition(matchInfo.position);
-                    cursor2.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
-                    selection2.cursor = cursor2;
-                    selection2.format.setBackground(matchColor);
-                    extraSelections.append(selection2);
-                }
-            }
+        if (bracketAfter && match != -1) {
+            extraSelections.append(bracketSelection(pos, matchColor));
+            extraSelections.append(bracketSelection(match, matchColor));
         }
     }
 
     setExtraSelections(extraSelections);
 }
 
+QTextEdit::ExtraSelection CodeEditor::bracketSelection(int position, const QColor &color)
+{
+    QTextEdit::ExtraSelection selection;
+    selection.cursor = textCursor();
+    selection.cursor.setPosition(position);
+    selection.cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
+    selection.format.setBackground(color);
+    return selection;
+}
+
 int CodeEditor::getIndentLevel(const QString &text)
 {
     int indent = 0;
@@ -442,72 +340,12 @@ int CodeEditor::getIndentLevel(const QString &text)
 
 int CodeEditor::findFoldEndLine(int startLine)
 {
-    QTextBlock startBlock = document()->findBlockByNumber(startLine);
-    if (!startBlock.isValid()) {
-        return -1;
-    }
-
-    QString startText = startBlock.text();
-    int startIndent = getIndentLevel(startText);
-
-    // Find the end of the fold region
-    int lineCount = document()->blockCount();
-    for (int i = startLine + 1; i < lineCount; ++i) {
-        QTextBlock block = document()->findBlockByNumber(i);
-        if (!block.isValid()) {
-            break;
-        }
-
-        QString text = block.text().trimmed();
-        // Skip empty lines
-        if (text.isEmpty()) {
-            continue;
-        }
-
-        int indent = getIndentLevel(block.text());
-        // If we find a line with same or less indentation, that's the end
-        if (indent <= startIndent) {
-            return i - 1;
-        }
-    }
-
-    // Fold to the end of document
-    return lineCount - 1;
+    return foldIndex.foldEnd(startLine);
 }
 
 bool CodeEditor::isFoldable(int lineNumber)
 {
-    QTextBlock block = document()->findBlockByNumber(lineNumber);
-    if (!block.isValid()) {
-        return false;
-    }
-
-    QString text = block.text();
-    // Empty lines are not foldable
-    if (text.trimmed().isEmpty()) {
-        return false;
-    }
-
-    // Check if next non-empty line has greater indentation
-    int currentIndent = getIndentLevel(text);
-    int lineCount = document()->blockCount();
-
-    for (int i = lineNumber + 1; i < lineCount; ++i) {
-        QTextBlock nextBlock = document()->findBlockByNumber(i);
-        if (!nextBlock.isValid()) {
-            break;
-        }
-
-        QString nextText = nextBlock.text();
-        if (nextText.trimmed().isEmpty()) {
-            continue;
-        }
-
-        int nextIndent = getIndentLevel(nextText);
-        return nextIndent > currentIndent;
-    }
-
-    return false;
+    return foldIndex.isFoldable(lineNumber);
 }
 
 bool CodeEditor::isBlockFolded(int lineNumber)
@@ -515,66 +353,85 @@ bool CodeEditor::isBlockFolded(int lineNumber)
     return foldedBlocks.contains(lineNumber);
 }
 
-void CodeEditor::setBlockVisible(int lineNumber, bool visible)
-{
-    QTextBlock block = document()->findBlockByNumber(lineNumber);
-    if (block.isValid()) {
-        block.setVisible(visible);
-    }
-}
-
 void CodeEditor::toggleFold(int lineNumber)
 {
-    if (!isFoldable(lineNumber)) {
+    int endLine = findFoldEndLine(lineNumber);
+    if (endLine < 0) {
         return;
     }
 
-    if (foldedBlocks.contains(lineNumber)) {
-        // Unfold
-        foldedBlocks.remove(lineNumber);
-
-        int endLine = findFoldEndLine(lineNumber);
-        for (int i = lineNumber + 1; i <= endLine; ++i) {
-            setBlockVisible(i, true);
-        }
-    } else {
-        // Fold
+    const bool fold = !foldedBlocks.contains(lineNumber);
+    if (fold) {
         foldedBlocks.insert(lineNumber);
+    } else {
+        foldedBlocks.remove(lineNumber);
+    }
 
-        int endLine = findFoldEndLine(lineNumber);
-        for (int i = lineNumber + 1; i <= endLine; ++i) {
-            setBlockVisible(i, false);
-        }
+    // Walk the range once and relayout only the blocks it covers
+    QTextBlock block = document()->findBlockByNumber(lineNumber);
+    const int start = block.position();
+    for (int i = lineNumber + 1; i <= endLine && block.next().isValid(); ++i) {
+        block = block.next();
+        block.setVisible(!fold);
     }
 
     // Update the editor
     viewport()->update();
     lineNumberArea->update();
-    document()->markContentsDirty(0, document()->characterCount());
+    document()->markContentsDirty(start, block.position() + block.length() - start);
 }
 
 void CodeEditor::foldAll()
 {
-    int lineCount = document()->blockCount();
-    for (int i = 0; i < lineCount; ++i) {
-        if (isFoldable(i) && !foldedBlocks.contains(i)) {
-            toggleFold(i);
+    // All fold ranges in one pass instead of a forward scan per line
+    const QVector<int> &foldEnds = foldIndex.foldEnds();
+    QSet<int> lines;
+    lines.reserve(foldEnds.size());
+    for (int i = 0; i < foldEnds.size(); ++i) {
+        if (foldEnds.at(i) >= 0) {
+            lines.insert(i);
         }
     }
+    applyFolds(foldEnds, lines);
 }
 
 void CodeEditor::unfoldAll()
 {
-    // Make all blocks visible
-    int lineCount = document()->blockCount();
-    for (int i = 0; i < lineCount; ++i) {
-        setBlockVisible(i, true);
-    }
+    applyFolds(QVector<int>(), QSet<int>());
+}
 
+void CodeEditor::applyFolds(const QVector<int> &foldEnds, const QSet<int> &lines)
+{
     foldedBlocks.clear();
+
+    // One walk over the blocks sets every visibility; a line is hidden while
+    // it is inside the range of an earlier folded line
+    int hiddenUntil = -1;
+    int changedStart = -1;
+    int changedEnd = -1;
+    int number = 0;
+    for (QTextBlock block = document()->begin(); block.isValid(); block = block.next(), ++number) {
+        const bool visible = number > hiddenUntil;
+        if (block.isVisible() != visible) {
+            block.setVisible(visible);
+            if (changedStart < 0) {
+                changedStart = block.position();
+            }
+            changedEnd = block.position() + block.length();
+        }
+
+        if (number < foldEnds.size() && foldEnds.at(number) >= 0 && lines.contains(number)) {
+            foldedBlocks.insert(number);
+            hiddenUntil = qMax(hiddenUntil, foldEnds.at(number));
+        }
+    }
+
+    // A single relayout covering just the blocks whose visibility changed
     viewport()->update();
     lineNumberArea->update();
-    document()->markContentsDirty(0, document()->characterCount());
+    if (changedStart >= 0) {
+        document()->markContentsDirty(changedStart, changedEnd - changedStart);
+    }
 }
 
 // Public accessors for protected methods
@@ -684,11 +541,8 @@ void CodeEditor::handleAutoCloseBracket(QChar openChar)
 
     // For quotes, check if we're next to the same quote (don't double it)
     if (openChar == '"' || openChar == '\'') {
-        int pos = cursor.position();
-        QString text = toPlainText();
-
         // If next character is the same quote, just move cursor forward
-        if (pos < text.length() && text[pos] == openChar) {
+        if (document()->characterAt(cursor.position()) == openChar) {
             cursor.movePosition(QTextCursor::Right);
             setTextCursor(cursor);
             return;
@@ -1204,49 +1058,33 @@ int CodeEditor::getBlockIndentLevel(const QTextBlock &block)
         return 0;
     }
 
-    QString text = block.text();
-    int indentLevel = 0;
-    int tabWidth = 4; // Standard tab width
-
-    for (int i = 0; i < text.length(); ++i) {
-        if (text[i] == ' ') {
-            indentLevel++;
-        } else if (text[i] == '\t') {
-            indentLevel += tabWidth;
-        } else {
-            // First non-whitespace character found
-            break;
-        }
-    }
-
-    return indentLevel;
+    // Cached per block and refreshed only when the block changes
+    return qMax(0, BlockData::of(block)->indent);
 }
 
 int CodeEditor::getActiveIndentLevel()
 {
-    QTextCursor cursor = textCursor();
-    QTextBlock currentBlock = cursor.block();
+    QTextBlock currentBlock = textCursor().block();
 
     if (!currentBlock.isValid()) {
         return 0;
     }
 
     // Get the indent level of the current line
-    int currentIndent = getBlockIndentLevel(currentBlock);
-
-    // If we're on a line with no indentation, look at surrounding lines
-    if (currentIndent == 0) {
-        // Check previous non-empty lines
-        QTextBlock prevBlock = currentBlock.previous();
-        while (prevBlock.isValid() && prevBlock.text().trimmed().isEmpty()) {
-            prevBlock = prevBlock.previous();
-        }
-        if (prevBlock.isValid()) {
-            currentIndent = getBlockIndentLevel(prevBlock);
+    int currentIndent = BlockData::of(currentBlock)->indent;
+
+    // If we're on a line with no indentation, look at the previous non-blank line
+    if (currentIndent <= 0) {
+        for (QTextBlock prevBlock = currentBlock.previous(); prevBlock.isValid(); prevBlock = prevBlock.previous()) {
+            const int indent = BlockData::of(prevBlock)->indent;
+            if (indent >= 0) {
+                currentIndent = indent;
+                break;
+            }
         }
     }
 
-    return currentIndent;
+    return qMax(0, currentIndent);
 }
 
 void CodeEditor::drawIndentationGuides(QPainter &painter)
@@ -1255,49 +1093,80 @@ void CodeEditor::drawIndentationGuides(QPainter &painter)
         return;
     }
 
-    QFontMetrics metrics(font());
-    int spaceWidth = metrics.horizontalAdvance(' ');
-    int tabWidth = 4; // Standard tab width
-    int indentWidth = spaceWidth * tabWidth;
+    const int tabWidth = 4; // Standard tab width, in columns
+    if (indentGuideSpaceWidth <= 0) {
+        indentGuideSpaceWidth = fontMetrics().horizontalAdvance(QLatin1Char(' '));
+    }
+    const qreal left = contentOffset().x() + document()->documentMargin();
 
     // Get active indent level for highlighting
     int activeIndent = highlightActiveIndent ? getActiveIndentLevel() : -1;
 
-    // Color for normal indent guides (subtle)
-    QColor normalColor = palette().color(QPalette::Mid);
-    normalColor.setAlpha(50);
-
-    // Color for active indent guide (more visible)
-    QColor activeColor = palette().color(QPalette::Highlight);
-    activeColor.setAlpha(100);
+    // Collect the guides of all visible lines, then draw them in two batches
+    QVector<QLineF> normalLines;
+    QVector<QLineF> activeLines;
 
     QTextBlock block = firstVisibleBlock();
-    int blockNumber = block.blockNumber();
     int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
     int bottom = top + qRound(blockBoundingRect(block).height());
+    const int viewportBottom = viewport()->rect().bottom();
+
+    // Blank lines continue the guides of the line above them, also when
+    // that line is scrolled out of view
+    int blockIndent = 0;
+    for (QTextBlock prevBlock = block.previous(); prevBlock.isValid(); prevBlock = prevBlock.previous()) {
+        const int indent = prevBlock.isVisible() ? BlockData::of(prevBlock)->indent : -1;
+        if (indent >= 0) {
+            blockIndent = indent;
+            break;
+        }
+    }
 
-    while (block.isValid() && top <= viewport()->rect().bottom()) {
-        if (block.isVisible() && bottom >= viewport()->rect().top()) {
-            int blockIndent = getBlockIndentLevel(block);
+    while (block.isValid() && top <= viewportBottom) {
+        if (block.isVisible() && bottom >= 0) {
+            const int indent = BlockData::of(block)->indent;
+            if (indent >= 0) {
+                blockIndent = indent;
+            }
 
             // Draw vertical lines for each indent level
-            for (int level = indentWidth; level < blockIndent; level += indentWidth) {
-                int x = level + contentOffset().x();
+            for (int column = tabWidth; column < blockIndent; column += tabWidth) {
+                const qreal x = left + column * indentGuideSpaceWidth;
 
                 // Check if this is the active indent level
-                bool isActive = (highlightActiveIndent &&
-                               level >= activeIndent - indentWidth &&
-                               level <= activeIndent);
+                const bool isActive = highlightActiveIndent &&
+                                      column >= activeIndent - tabWidth &&
+                                      column <= activeIndent;
 
-                painter.setPen(isActive ? activeColor : normalColor);
-                painter.drawLine(x, top, x, bottom);
+                (isActive ? activeLines : normalLines).append(QLineF(x, top, x, bottom));
             }
         }
 
         block = block.next();
         top = bottom;
         bottom = top + qRound(blockBoundingRect(block).height());
-        ++blockNumber;
+    }
+
+    // Color for normal indent guides (subtle)
+    QColor normalColor = palette().color(QPalette::Mid);
+    normalColor.setAlpha(50);
+
+    // Color for active indent guide (more visible)
+    QColor activeColor = palette().color(QPalette::Highlight);
+    activeColor.setAlpha(100);
+
+    painter.setPen(normalColor);
+    painter.drawLines(normalLines);
+    painter.setPen(activeColor);
+    painter.drawLines(activeLines);
+}
+
+void CodeEditor::changeEvent(QEvent *event)
+{
+    QPlainTextEdit::changeEvent(event);
+
+    if (event->type() == QEvent::FontChange) {
+        indentGuideSpaceWidth = 0;
     }
 }
 
@@ -1320,12 +1189,14 @@ void CodeEditor::toggleBookmarkAtLine(int lineNumber)
 
     // Trigger repaint of line number area
     lineNumberArea->update();
+    emit bookmarksChanged();
 }
 
 void CodeEditor::clearAllBookmarks()
 {
     bookmarkedLines.clear();
     lineNumberArea->update();
+    emit bookmarksChanged();
 }
 
 void CodeEditor::goToNextBookmark()
@@ -1394,6 +1265,7 @@ void CodeEditor::setBookmarks(const QSet<int> &bookmarks)
 {
     bookmarkedLines = bookmarks;
     lineNumberArea->update();
+    emit bookmarksChanged();
 }
 
 // Line operations implementation
@@ -5,7 +5,10 @@
 #include <QWidget>
 #include <QSet>
 #include <QList>
+#include <QVector>
 #include <QTextCursor>
+#include "foldindex.h"
+#include "gutteratlas.h"
 
 class LineNumberArea;
 
@@ -33,6 +36,7 @@ public:
     bool isFoldable(int lineNumber);
     void foldAll();
     void unfoldAll();
+    QSet<int> getFoldedLines() const { return foldedBlocks; }
 
     // Public accessors for protected methods (for LineNumberArea)
     QTextBlock getFirstVisibleBlock() const;
@@ -40,6 +44,10 @@ public:
     QRectF getBlockBoundingRect(const QTextBlock &block) const;
     QPointF getContentOffset() const;
 
+    // Range of blocks currently on screen
+    int firstVisibleBlockNumber() const { return visibleFirstBlock; }
+    int lastVisibleBlockNumber() const { return visibleLastBlock; }
+
     // Smart editing features
     void setAutoIndent(bool enable);
     void setAutoCloseBrackets(bool enable);
@@ -88,8 +96,13 @@ public:
     void setCurrentLanguage(const QString &language);
     QString getCurrentLanguage() const { return currentLanguage; }
 
+signals:
+    void visibleBlocksChanged(int firstBlock, int lastBlock);
+    void bookmarksChanged();
+
 protected:
     void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
@@ -98,10 +111,13 @@ private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void updateLineNumberArea(const QRect &rect, int dy);
     void matchBrackets();
+    void updateVisibleBlocks();
 
 private:
     QWidget *lineNumberArea;
     bool compactMode;
+    int visibleFirstBlock;
+    int visibleLastBlock;
 
     // Line wrapping settings
     bool showWrapIndicator;
@@ -120,22 +136,16 @@ private:
     // Indentation guides
     bool showIndentationGuides;
     bool highlightActiveIndent;
+    int indentGuideSpaceWidth = 0;  // Width of a space in the editor font, 0 until measured
 
-    struct BracketInfo {
-        QChar character;
-        int position;
-    };
-
-    BracketInfo findMatchingBracket(QChar bracket, int position, bool forward);
-    bool isOpeningBracket(QChar c);
-    bool isClosingBracket(QChar c);
-    QChar getMatchingBracket(QChar c);
+    // Bracket matching helper
+    QTextEdit::ExtraSelection bracketSelection(int position, const QColor &color);
 
     // Code folding helpers
     int getIndentLevel(const QString &text);
     int findFoldEndLine(int startLine);
-    void setBlockVisible(int lineNumber, bool visible);
     bool isBlockFolded(int lineNumber);
+    void applyFolds(const QVector<int> &foldEnds, const QSet<int> &lines);
 
     // Smart editing helpers
     QString getIndentationOfLine(const QString &text);
@@ -161,6 +171,8 @@ private:
     QPair<QString, QString> getBlockCommentSyntax() const;
     bool isLineCommented(const QString &line, const QString &commentSyntax) const;
 
+    GutterAtlas gutterAtlas;  // Pre-rendered line numbers and gutter icons
+    FoldIndex foldIndex;      // Fold ranges of the document, found once per change
     QSet<int> foldedBlocks;  // Track which lines are folded
     QSet<int> bookmarkedLines;  // Track which lines are bookmarked
     QString currentLanguage;  // Current language for comment syntax
@@ -170,7 +182,10 @@ class LineNumberArea : public QWidget
 {
 public:
     LineNumberArea(CodeEditor *editor) : QWidget(editor), codeEditor(editor)
-    {}
+    {
+        // The paint event fills its whole rect; lets scroll() blit instead of repainting
+        setAttribute(Qt::WA_OpaquePaintEvent);
+    }
 
     QSize sizeHint() const override
     {
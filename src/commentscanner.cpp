@@ -0,0 +1,96 @@
+#include "commentscanner.h"
+
+namespace {
+
+const int DepthShift = 8;
+const int PairMask = (1 << DepthShift) - 1;
+
+} // namespace
+
+CommentScanner::CommentScanner(const QVector<CommentDelimiters> &delimiters, bool nested)
+    : nested(nested)
+{
+    for (const CommentDelimiters &pair : delimiters) {
+        if (!pair.start.isEmpty() && !pair.end.isEmpty() && pairs.size() < PairMask) {
+            pairs.append(pair);
+        }
+    }
+}
+
+int CommentScanner::scan(const QString &text, int previousState, QVector<TokenRun> *spans) const
+{
+    if (spans) {
+        spans->clear();
+    }
+
+    // Decode the comment left open by the previous block, if any
+    int pair = -1;
+    int depth = 0;
+    if (previousState > 0) {
+        pair = (previousState & PairMask) - 1;
+        depth = (previousState >> DepthShift) + 1;
+        if (pair >= pairs.size()) {
+            pair = -1;
+            depth = 0;
+        }
+    }
+
+    const int length = text.length();
+    int commentStart = 0;
+    int pos = 0;
+
+    while (pos < length) {
+        if (depth == 0) {
+            // Earliest start delimiter of any pair
+            int startIndex = -1;
+            for (int i = 0; i < pairs.size(); ++i) {
+                int index = text.indexOf(pairs.at(i).start, pos);
+                if (index >= 0 && (startIndex < 0 || index < startIndex)) {
+                    startIndex = index;
+                    pair = i;
+                }
+            }
+            if (startIndex < 0) {
+                break;
+            }
+
+            commentStart = startIndex;
+            depth = 1;
+            pos = startIndex + pairs.at(pair).start.length();
+            continue;
+        }
+
+        const CommentDelimiters &delimiters = pairs.at(pair);
+        int endIndex = text.indexOf(delimiters.end, pos);
+
+        if (nested && delimiters.start != delimiters.end) {
+            int nestedIndex = text.indexOf(delimiters.start, pos);
+            if (nestedIndex >= 0 && (endIndex < 0 || nestedIndex < endIndex)) {
+                ++depth;
+                pos = nestedIndex + delimiters.start.length();
+                continue;
+            }
+        }
+
+        if (endIndex < 0) {
+            break;
+        }
+
+        pos = endIndex + delimiters.end.length();
+        if (--depth == 0) {
+            if (spans) {
+                spans->append({commentStart, pos - commentStart, pair});
+            }
+        }
+    }
+
+    if (depth == 0) {
+        return 0;
+    }
+
+    // Still open at the end of the line
+    if (spans) {
+        spans->append({commentStart, length - commentStart, pair});
+    }
+    return (pair + 1) + ((depth - 1) << DepthShift);
+}
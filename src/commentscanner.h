@@ -0,0 +1,43 @@
+#ifndef COMMENTSCANNER_H
+#define COMMENTSCANNER_H
+
+#include <QString>
+#include <QVector>
+#include "syntaxtokenizer.h"
+
+// Start and end delimiter of one kind of multiline comment
+struct CommentDelimiters {
+    QString start;
+    QString end;
+};
+
+/**
+ * @brief State machine for comments that span several blocks
+ *
+ * Delimiters are fixed strings and are found with a plain substring search.
+ * A language may define several pairs (Python's triple quotes) and may
+ * allow comments to nest (Rust, Swift, Julia). The block state carries the
+ * open pair and the nesting depth from one line to the next:
+ * 0 outside a comment, otherwise (pair + 1) + (depth - 1) * 256.
+ *
+ * Scanning does not allocate once the span vector has grown to its working
+ * size, so the scanner can run on every block.
+ */
+class CommentScanner
+{
+public:
+    CommentScanner() = default;
+    CommentScanner(const QVector<CommentDelimiters> &delimiters, bool nested);
+
+    bool isEmpty() const { return pairs.isEmpty(); }
+
+    // Scan one line that follows a block in previousState. Comment spans are
+    // written to spans (cleared first, may be null); returns the line's state.
+    int scan(const QString &text, int previousState, QVector<TokenRun> *spans) const;
+
+private:
+    QVector<CommentDelimiters> pairs;
+    bool nested = false;
+};
+
+#endif // COMMENTSCANNER_H
@@ -1,120 +1,298 @@
 #include "encodingmanager.h"
+#include "simdscan.h"
 #include <QDebug>
+#include <cstring>
 
 EncodingManager::EncodingManager()
 {
 }
 
+namespace {
+
+// The start and the end of the data that detection reads
+const qint64 HeadSampleBytes = 64 * 1024;
+const qint64 TailSampleBytes = 16 * 1024;
+
+// Continuation bytes after a lead byte, or -1 if it cannot start a sequence
+int continuationBytes(unsigned char c)
+{
+    if ((c & 0xE0) == 0xC0) {
+        return 1; // 2-byte sequence
+    }
+    if ((c & 0xF0) == 0xE0) {
+        return 2; // 3-byte sequence
+    }
+    if ((c & 0xF8) == 0xF0) {
+        return 3; // 4-byte sequence
+    }
+    return -1;
+}
+
+// Check data[from, to) a byte at a time; see checkUtf8()
+bool scanUtf8(const unsigned char *data, qint64 from, qint64 to, int *pending, bool *ascii)
+{
+    for (qint64 i = from; i < to; ++i) {
+        const unsigned char c = data[i];
+        if (*pending > 0) {
+            if ((c & 0xC0) != 0x80) {
+                return false; // Invalid continuation byte
+            }
+            --*pending;
+            continue;
+        }
+        if (c <= 0x7F) {
+            continue;
+        }
+        *ascii = false;
+        *pending = continuationBytes(c);
+        if (*pending < 0) {
+            return false; // Invalid UTF-8 start byte
+        }
+    }
+    return true;
+}
+
+// Continuation bytes still owed at data + at, from the three bytes before it
+// in data already found valid
+int pendingBefore(const unsigned char *data, qint64 at)
+{
+    for (int back = 1; back <= 3; ++back) {
+        if (data[at - back] >= 0xC0) {
+            return qMax(0, continuationBytes(data[at - back]) - (back - 1));
+        }
+    }
+    return 0;
+}
+
+// Check that data[0, size) continues valid UTF-8. *pending is the number of
+// continuation bytes owed by a sequence begun before data, and receives
+// those owed after it; *ascii is cleared at the first byte above 127.
+bool checkUtf8(const unsigned char *data, qint64 size, int *pending, bool *ascii)
+{
+    // The vector kernel reads three bytes back, so those are checked here;
+    // the bytes it leaves at the end go the same way
+    const qint64 head = qMin<qint64>(3, size);
+    if (!scanUtf8(data, 0, head, pending, ascii)) {
+        return false;
+    }
+    const qint64 scanned = SimdScan::checkUtf8(data, head, size, ascii);
+    if (scanned < 0) {
+        return false;
+    }
+    if (scanned > head) {
+        *pending = pendingBefore(data, scanned);
+    }
+    return scanUtf8(data, scanned, size, pending, ascii);
+}
+
+// UTF-32 code points converted a block at a time, through a buffer that
+// stays in cache when their bytes need swapping first
+const qint64 StagingCodePoints = 4096;
+
+// Convert UTF-32 code points to UTF-16 in dst, which has room for two units
+// each; returns the units written. Code points that are not characters
+// become U+FFFD, as with QString::fromUcs4().
+qint64 utf32ToUtf16(const char *src, qint64 count, bool swap, char16_t *dst)
+{
+    char32_t staging[StagingCodePoints];
+    qint64 written = 0;
+    for (qint64 done = 0; done < count; done += StagingCodePoints) {
+        const qint64 blockSize = qMin(StagingCodePoints, count - done);
+        const char *block = src + done * 4;
+        if (swap) {
+            SimdScan::swapBytes32(block, reinterpret_cast<char *>(staging), blockSize);
+            block = reinterpret_cast<const char *>(staging);
+        }
+        for (qint64 i = 0; i < blockSize; ++i) {
+            const qint64 narrowed = SimdScan::narrowUtf32(block + i * 4, dst + written, blockSize - i);
+            i += narrowed;
+            written += narrowed;
+            if (i == blockSize) {
+                break;
+            }
+            char32_t c;
+            std::memcpy(&c, block + i * 4, 4);
+            if (QChar::requiresSurrogates(c) && c <= QChar::LastValidCodePoint) {
+                dst[written++] = QChar::highSurrogate(c);
+                dst[written++] = QChar::lowSurrogate(c);
+            } else {
+                dst[written++] = QChar::ReplacementCharacter; // Surrogate or beyond Unicode
+            }
+        }
+    }
+    return written;
+}
+
+// Convert UTF-16 to native UTF-32 code points in dst, which has room for
+// one per unit; returns the code points written. Unpaired surrogates become
+// U+FFFD, as with QString::toUcs4().
+qint64 utf16ToUtf32(const char16_t *src, qint64 count, char *dst)
+{
+    qint64 written = 0;
+    for (qint64 i = 0; i < count; ++i) {
+        const qint64 widened = SimdScan::widenUtf16(src + i, dst + written * 4, count - i);
+        i += widened;
+        written += widened;
+        if (i == count) {
+            break;
+        }
+        char32_t c = QChar::ReplacementCharacter;
+        if (QChar::isHighSurrogate(src[i]) && i + 1 < count && QChar::isLowSurrogate(src[i + 1])) {
+            c = QChar::surrogateToUcs4(src[i], src[i + 1]);
+            ++i;
+        }
+        std::memcpy(dst + written * 4, &c, 4);
+        ++written;
+    }
+    return written;
+}
+
+} // namespace
+
 EncodingManager::Encoding EncodingManager::detectEncoding(const QByteArray &data)
 {
-    if (data.isEmpty()) {
-        return Encoding::UTF8; // Default
+    const Detection detection = detect(data);
+    if (detection.isCertain()) {
+        return detection.encoding;
+    }
+
+    // The sample did not settle it; every byte has the last word
+    StreamValidator validator;
+    validator.append(data.constData(), data.size());
+    validator.finish();
+    return validator.encoding();
+}
+
+EncodingManager::Detection EncodingManager::detect(const QByteArray &data)
+{
+    if (data.size() <= HeadSampleBytes + TailSampleBytes) {
+        return detect(data, QByteArray(), data.size());
+    }
+    return detect(QByteArray::fromRawData(data.constData(), HeadSampleBytes),
+                  QByteArray::fromRawData(data.constData() + data.size() - TailSampleBytes, TailSampleBytes),
+                  data.size());
+}
+
+EncodingManager::Detection EncodingManager::detect(const QByteArray &head, const QByteArray &tail, qint64 size)
+{
+    if (head.isEmpty()) {
+        return {Encoding::UTF8, 1.0}; // Default
     }
 
     // Check for BOM (Byte Order Mark)
-    if (data.size() >= 3) {
+    if (head.size() >= 3) {
         // UTF-8 BOM: EF BB BF
-        if ((unsigned char)data[0] == 0xEF &&
-            (unsigned char)data[1] == 0xBB &&
-            (unsigned char)data[2] == 0xBF) {
-            return Encoding::UTF8;
+        if ((unsigned char)head[0] == 0xEF &&
+            (unsigned char)head[1] == 0xBB &&
+            (unsigned char)head[2] == 0xBF) {
+            return {Encoding::UTF8, 1.0};
         }
     }
 
-    if (data.size() >= 2) {
+    if (head.size() >= 2) {
         // UTF-16 LE BOM: FF FE
-        if ((unsigned char)data[0] == 0xFF &&
-            (unsigned char)data[1] == 0xFE) {
-            return Encoding::UTF16LE;
+        if ((unsigned char)head[0] == 0xFF &&
+            (unsigned char)head[1] == 0xFE) {
+            return {Encoding::UTF16LE, 1.0};
         }
         // UTF-16 BE BOM: FE FF
-        if ((unsigned char)data[0] == 0xFE &&
-            (unsigned char)data[1] == 0xFF) {
-            return Encoding::UTF16BE;
+        if ((unsigned char)head[0] == 0xFE &&
+            (unsigned char)head[1] == 0xFF) {
+            return {Encoding::UTF16BE, 1.0};
         }
     }
 
-    if (data.size() >= 4) {
+    if (head.size() >= 4) {
         // UTF-32 LE BOM: FF FE 00 00
-        if ((unsigned char)data[0] == 0xFF &&
-            (unsigned char)data[1] == 0xFE &&
-            (unsigned char)data[2] == 0x00 &&
-            (unsigned char)data[3] == 0x00) {
-            return Encoding::UTF32LE;
+        if ((unsigned char)head[0] == 0xFF &&
+            (unsigned char)head[1] == 0xFE &&
+            (unsigned char)head[2] == 0x00 &&
+            (unsigned char)head[3] == 0x00) {
+            return {Encoding::UTF32LE, 1.0};
         }
         // UTF-32 BE BOM: 00 00 FE FF
-        if ((unsigned char)data[0] == 0x00 &&
-            (unsigned char)data[1] == 0x00 &&
-            (unsigned char)data[2] == 0xFE &&
-            (unsigned char)data[3] == 0xFF) {
-            return Encoding::UTF32BE;
+        if ((unsigned char)head[0] == 0x00 &&
+            (unsigned char)head[1] == 0x00 &&
+            (unsigned char)head[2] == 0xFE &&
+            (unsigned char)head[3] == 0xFF) {
+            return {Encoding::UTF32BE, 1.0};
         }
     }
 
-    // No BOM - try to detect encoding by content
-    if (isASCII(data)) {
-        return Encoding::ASCII;
+    // No BOM - try to detect encoding by content. A sequence cut off at the
+    // end of the head continues in bytes not read.
+    bool ascii = true;
+    int pending = 0;
+    bool valid = checkUtf8(reinterpret_cast<const unsigned char *>(head.constData()), head.size(), &pending, &ascii);
+    if (valid && head.size() >= size) {
+        valid = pending == 0;
+    } else if (valid && !tail.isEmpty()) {
+        // The tail starts at the next sequence, then runs to the end of the data
+        qsizetype start = 0;
+        while (start < qMin<qsizetype>(3, tail.size()) && ((unsigned char)tail[start] & 0xC0) == 0x80) {
+            ++start;
+        }
+        pending = 0;
+        valid = checkUtf8(reinterpret_cast<const unsigned char *>(tail.constData()) + start, tail.size() - start,
+                          &pending, &ascii) && pending == 0;
     }
 
-    if (isUTF8(data)) {
-        return Encoding::UTF8;
+    // Default to ISO-8859-1 (Latin-1) as fallback for 8-bit encodings
+    // This is a safe fallback since it maps all byte values to Unicode,
+    // and no unread byte can make the data UTF-8 again
+    if (!valid) {
+        return {Encoding::ISO_8859_1, 1.0};
     }
 
-    // Default to ISO-8859-1 (Latin-1) as fallback for 8-bit encodings
-    // This is a safe fallback since it maps all byte values to Unicode
-    return Encoding::ISO_8859_1;
+    // Any unread byte may be above 127; multi-byte sequences that were read
+    // make UTF-8 likely, though unread bytes may still not be UTF-8
+    const double covered = size > 0 ? qMin(1.0, double(head.size() + tail.size()) / size) : 1.0;
+    if (ascii) {
+        return {Encoding::ASCII, covered};
+    }
+    return {Encoding::UTF8, (1.0 + covered) / 2};
 }
 
-bool EncodingManager::isASCII(const QByteArray &data)
+EncodingManager::StreamValidator::StreamValidator()
+    : ascii(true)
+    , valid(true)
+    , pending(0)
 {
-    for (int i = 0; i < data.size(); ++i) {
-        if ((unsigned char)data[i] > 127) {
-            return false;
-        }
-    }
-    return true;
 }
 
-bool EncodingManager::isUTF8(const QByteArray &data)
+void EncodingManager::StreamValidator::append(const char *data, qint64 size)
 {
-    int i = 0;
-    while (i < data.size()) {
-        unsigned char c = (unsigned char)data[i];
-
-        // ASCII character
-        if (c <= 0x7F) {
-            i++;
-            continue;
-        }
-
-        // Multi-byte sequence
-        int extraBytes = 0;
-        if ((c & 0xE0) == 0xC0) {
-            extraBytes = 1; // 2-byte sequence
-        } else if ((c & 0xF0) == 0xE0) {
-            extraBytes = 2; // 3-byte sequence
-        } else if ((c & 0xF8) == 0xF0) {
-            extraBytes = 3; // 4-byte sequence
-        } else {
-            return false; // Invalid UTF-8 start byte
-        }
+    if (valid) {
+        valid = checkUtf8(reinterpret_cast<const unsigned char *>(data), size, &pending, &ascii);
+    }
+}
 
-        // Check continuation bytes
-        for (int j = 0; j < extraBytes; ++j) {
-            i++;
-            if (i >= data.size()) {
-                return false; // Incomplete sequence
-            }
-            unsigned char cont = (unsigned char)data[i];
-            if ((cont & 0xC0) != 0x80) {
-                return false; // Invalid continuation byte
-            }
-        }
+void EncodingManager::StreamValidator::finish()
+{
+    if (pending > 0) {
+        valid = false; // Incomplete sequence
+    }
+}
 
-        i++;
+EncodingManager::Encoding EncodingManager::StreamValidator::encoding() const
+{
+    if (!valid) {
+        return Encoding::ISO_8859_1;
     }
+    return ascii ? Encoding::ASCII : Encoding::UTF8;
+}
 
-    return true;
+bool EncodingManager::isASCII(const QByteArray &data)
+{
+    return SimdScan::asciiPrefix(data.constData(), data.size()) == data.size();
+}
+
+bool EncodingManager::isUTF8(const QByteArray &data)
+{
+    bool ascii = true;
+    int pending = 0;
+    return checkUtf8(reinterpret_cast<const unsigned char *>(data.constData()), data.size(), &pending, &ascii) &&
+           pending == 0;
 }
 
 QString EncodingManager::encodingName(Encoding encoding)
@@ -164,56 +342,47 @@ EncodingManager::Encoding EncodingManager::encodingFromName(const QString &name)
 
 QString EncodingManager::decode(const QByteArray &data, Encoding encoding)
 {
-    QByteArray cleanData = data;
-
-    // Remove BOM if present
+    // Skip the BOM in place rather than copying the rest
+    const char *bytes = data.constData();
+    qsizetype size = data.size();
     if (hasBOM(data)) {
         QByteArray bom = getBOM(encoding);
         if (!bom.isEmpty() && data.startsWith(bom)) {
-            cleanData = data.mid(bom.size());
+            bytes += bom.size();
+            size -= bom.size();
         }
     }
 
     switch (encoding) {
         case Encoding::UTF8:
-            return QString::fromUtf8(cleanData);
+            return QString::fromUtf8(QByteArrayView(bytes, size));
         case Encoding::UTF16LE:
-            return QString::fromUtf16(reinterpret_cast<const char16_t*>(cleanData.data()),
-                                     cleanData.size() / 2);
+            return QString::fromUtf16(reinterpret_cast<const char16_t*>(bytes), size / 2);
         case Encoding::UTF16BE: {
-            // Qt doesn't have direct BE support, need to swap bytes
-            QByteArray swapped;
-            for (int i = 0; i < cleanData.size() - 1; i += 2) {
-                swapped.append(cleanData[i + 1]);
-                swapped.append(cleanData[i]);
-            }
-            return QString::fromUtf16(reinterpret_cast<const char16_t*>(swapped.data()),
-                                     swapped.size() / 2);
+            // Qt doesn't have direct BE support; the bytes are swapped
+            // straight into the string
+            QString text(size / 2, Qt::Uninitialized);
+            SimdScan::swapBytes16(bytes, reinterpret_cast<char*>(text.data()), size / 2);
+            return text;
         }
         case Encoding::UTF32LE:
-            return QString::fromUcs4(reinterpret_cast<const char32_t*>(cleanData.data()),
-                                    cleanData.size() / 4);
         case Encoding::UTF32BE: {
-            // Swap bytes for BE
-            QByteArray swapped;
-            for (int i = 0; i < cleanData.size() - 3; i += 4) {
-                swapped.append(cleanData[i + 3]);
-                swapped.append(cleanData[i + 2]);
-                swapped.append(cleanData[i + 1]);
-                swapped.append(cleanData[i]);
-            }
-            return QString::fromUcs4(reinterpret_cast<const char32_t*>(swapped.data()),
-                                    swapped.size() / 4);
+            // Sized for a surrogate pair per code point, then cut to length
+            QString text(size / 4 * 2, Qt::Uninitialized);
+            const qint64 units = utf32ToUtf16(bytes, size / 4, encoding == Encoding::UTF32BE,
+                                              reinterpret_cast<char16_t*>(text.data()));
+            text.truncate(units);
+            return text;
         }
         case Encoding::ISO_8859_1:
-            return QString::fromLatin1(cleanData);
+            return QString::fromLatin1(QByteArrayView(bytes, size));
         case Encoding::ISO_8859_15:
         case Encoding::Windows_1252:
         case Encoding::ASCII:
             // For these, use Latin1 as approximation (works for ASCII and is close for others)
-            return QString::fromLatin1(cleanData);
+            return QString::fromLatin1(QByteArrayView(bytes, size));
         default:
-            return QString::fromUtf8(cleanData);
+            return QString::fromUtf8(QByteArrayView(bytes, size));
     }
 }
 
@@ -235,28 +404,22 @@ QByteArray EncodingManager::encode(const QString &text, Encoding encoding, bool
             break;
         }
         case Encoding::UTF16BE: {
-            const ushort *utf16 = text.utf16();
             // Swap bytes for BE
-            for (int i = 0; i < text.size(); ++i) {
-                ushort c = utf16[i];
-                result.append((c >> 8) & 0xFF);
-                result.append(c & 0xFF);
-            }
-            break;
-        }
-        case Encoding::UTF32LE: {
-            QVector<uint> utf32 = text.toUcs4();
-            result = QByteArray(reinterpret_cast<const char*>(utf32.data()), utf32.size() * 4);
+            result = QByteArray(text.size() * 2, Qt::Uninitialized);
+            SimdScan::swapBytes16(reinterpret_cast<const char*>(text.utf16()), result.data(), text.size());
             break;
         }
+        case Encoding::UTF32LE:
         case Encoding::UTF32BE: {
-            QVector<uint> utf32 = text.toUcs4();
-            // Swap bytes for BE
-            for (uint c : utf32) {
-                result.append((c >> 24) & 0xFF);
-                result.append((c >> 16) & 0xFF);
-                result.append((c >> 8) & 0xFF);
-                result.append(c & 0xFF);
+            // Sized for a code point per unit, then cut to length; BE is
+            // swapped in place
+            result = QByteArray(text.size() * 4, Qt::Uninitialized);
+            const qint64 codePoints = utf16ToUtf32(reinterpret_cast<const char16_t*>(text.utf16()), text.size(),
+                                                   result.data());
+            result.truncate(codePoints * 4);
+            if (encoding == Encoding::UTF32BE) {
+                char *bytes = result.data();
+                SimdScan::swapBytes32(bytes, bytes, codePoints);
             }
             break;
         }
@@ -33,13 +33,77 @@ public:
 
     EncodingManager();
 
+    /**
+     * @brief Encoding detected from a sample, and how far the rest is known to agree
+     *
+     * confidence is 1 when the result holds for the whole data: a BOM was
+     * found, every byte was read, or bytes that are not UTF-8 were seen.
+     * Otherwise it grows with the share of the data that was read.
+     */
+    struct Detection {
+        Encoding encoding;
+        double confidence;
+
+        bool isCertain() const { return confidence >= 1.0; }
+    };
+
     /**
      * @brief Detect encoding from byte array
      * @param data The raw file data
      * @return Detected encoding
+     *
+     * Every byte is checked unless a BOM or the sample settles it; detect()
+     * reads only the start and the end of large data.
      */
     static Encoding detectEncoding(const QByteArray &data);
 
+    /**
+     * @brief Detect encoding from a bounded sample of the data
+     * @param data The raw file data
+     * @return Detected encoding with its confidence
+     *
+     * Reads the first 64 KB and the last 16 KB, so its cost does not grow
+     * with the file.
+     */
+    static Detection detect(const QByteArray &data);
+
+    /**
+     * @brief Detect encoding from the start and the end of data not read in full
+     * @param head The first bytes of the data
+     * @param tail The last bytes of the data (may be empty)
+     * @param size Size of the whole data
+     * @return Detected encoding with its confidence
+     */
+    static Detection detect(const QByteArray &head, const QByteArray &tail, qint64 size);
+
+    /**
+     * @brief Checks data chunk by chunk as it is read
+     *
+     * For data whose detection was not certain: fed every chunk from the
+     * start, it tells ASCII, UTF-8 and the Latin-1 fallback apart the way
+     * detection on the whole data would, without a second pass over it.
+     * Data with a BOM needs no checking.
+     */
+    class StreamValidator
+    {
+    public:
+        StreamValidator();
+
+        // The next bytes of the data
+        void append(const char *data, qint64 size);
+
+        // No more data follows; a sequence left unfinished is invalid UTF-8
+        void finish();
+
+        // ASCII, UTF8 or ISO_8859_1 for the bytes appended so far
+        Encoding encoding() const;
+
+    private:
+        bool ascii;
+        bool valid;   // Valid UTF-8 so far
+        int pending;  // Continuation bytes the last sequence still needs
+    };
+
     /**
      * @brief Get human-readable name for encoding
      * @param encoding The encoding to name
@@ -107,8 +171,18 @@ public:
      */
     static QByteArray getBOM(Encoding encoding);
 
-private:
+    /**
+     * @brief Check if data is valid UTF-8
+     * @param data The raw data
+     * @return True if every sequence is complete and well-formed
+     */
     static bool isUTF8(const QByteArray &data);
+
+    /**
+     * @brief Check if data is plain ASCII
+     * @param data The raw data
+     * @return True if no byte is above 127
+     */
     static bool isASCII(const QByteArray &data);
 };
 
@@ -0,0 +1,190 @@
+#include "fileloader.h"
+#include <QFile>
+
+namespace {
+
+// The first chunk is small so the start of the file shows at once
+const qint64 FirstChunkBytes = 64 * 1024;
+const qint64 ChunkBytes = 1024 * 1024;
+
+// End of the file read for encoding detection before the first chunk
+const qint64 TailSampleBytes = 16 * 1024;
+
+// Line breaks are found at multiples of the code unit size
+int codeUnitBytes(EncodingManager::Encoding encoding)
+{
+    switch (encoding) {
+    case EncodingManager::Encoding::UTF16LE:
+    case EncodingManager::Encoding::UTF16BE:
+        return 2;
+    case EncodingManager::Encoding::UTF32LE:
+    case EncodingManager::Encoding::UTF32BE:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+// Offset just after the last line break in data[from, end), or from if there
+// is none; a cut there never splits a character
+qint64 afterLastLineBreak(const QByteArray &data, qint64 from, qint64 end, EncodingManager::Encoding encoding)
+{
+    const int unit = codeUnitBytes(encoding);
+    const bool bigEndian = encoding == EncodingManager::Encoding::UTF16BE ||
+                           encoding == EncodingManager::Encoding::UTF32BE;
+    const int newlineByte = bigEndian ? unit - 1 : 0;  // Where '\n' sits in its code unit
+
+    qint64 at = end > from ? data.lastIndexOf('\n', end - 1) : -1;
+    while (at >= from) {
+        const qint64 unitStart = at - newlineByte;
+        if (unitStart >= 0 && unitStart % unit == 0 && unitStart + unit <= end) {
+            bool isNewline = true;
+            for (int i = 0; i < unit; ++i) {
+                if (i != newlineByte && data.at(unitStart + i) != '\0') {
+                    isNewline = false;
+                }
+            }
+            if (isNewline) {
+                return unitStart + unit;
+            }
+        }
+        if (at == 0) {
+            break;
+        }
+        at = data.lastIndexOf('\n', at - 1);
+    }
+    return from;
+}
+
+} // namespace
+
+FileLoader::FileLoader(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , path(fileName)
+    , fileEncoding(EncodingManager::Encoding::UTF8)
+    , worker(nullptr)
+    , cancelled(0)
+{
+}
+
+FileLoader::~FileLoader()
+{
+    cancelled.storeRelaxed(1);
+    if (worker) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+void FileLoader::start()
+{
+    if (worker) {
+        return;
+    }
+    worker = QThread::create([this]() { load(); });
+    connect(worker, &QThread::finished, this, &FileLoader::onWorkerFinished);
+    worker->start();
+}
+
+void FileLoader::onWorkerFinished()
+{
+    if (worker) {
+        worker->deleteLater();
+        worker = nullptr;
+    }
+}
+
+void FileLoader::load()
+{
+    // Runs on the worker; results are posted to the loader's thread, where
+    // they are dropped if the loader has gone
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        const QString error = file.errorString();
+        QMetaObject::invokeMethod(this, [this, error]() { emit failed(error); }, Qt::QueuedConnection);
+        return;
+    }
+
+    const qint64 total = file.size();
+
+    // Detection reads the first chunk and the end of the file
+    QByteArray tail;
+    if (total > FirstChunkBytes) {
+        const qint64 tailBytes = qMin(TailSampleBytes, total - FirstChunkBytes);
+        if (file.seek(total - tailBytes)) {
+            tail = file.read(tailBytes);
+        }
+        file.seek(0);
+    }
+
+    QByteArray data;
+    data.reserve(total);
+
+    // Unless detection is certain, every chunk is checked as it is read
+    EncodingManager::Detection detection = {EncodingManager::Encoding::UTF8, 1.0};
+    EncodingManager::StreamValidator validator;
+    EncodingManager::Encoding encoding = EncodingManager::Encoding::Unknown;
+    qint64 handedOver = 0;  // Bytes decoded and posted so far
+    qint64 chunkBytes = FirstChunkBytes;
+    while (!file.atEnd()) {
+        if (cancelled.loadRelaxed()) {
+            return;
+        }
+        const QByteArray chunk = file.read(chunkBytes);
+        if (chunk.isEmpty()) {
+            const QString error = file.errorString();
+            QMetaObject::invokeMethod(this, [this, error]() { emit failed(error); }, Qt::QueuedConnection);
+            return;
+        }
+        data.append(chunk);
+        chunkBytes = ChunkBytes;
+
+        if (encoding == EncodingManager::Encoding::Unknown) {
+            detection = EncodingManager::detect(chunk, tail, total);
+            encoding = detection.encoding;
+        }
+        if (!detection.isCertain()) {
+            validator.append(chunk.constData(), chunk.size());
+
+            // Text handed over as ASCII reads the same in UTF-8 and Latin-1,
+            // so the first byte above 127 may still change the encoding
+            if (encoding == EncodingManager::Encoding::ASCII) {
+                encoding = validator.encoding();
+            }
+        }
+
+        const qint64 end = file.atEnd() ? data.size() : afterLastLineBreak(data, handedOver, data.size(), encoding);
+        if (end == handedOver) {
+            continue;
+        }
+        const QString text = EncodingManager::decode(data.mid(handedOver, end - handedOver), encoding);
+        handedOver = end;
+        const int percent = total > 0 ? int(handedOver * 100 / total) : 100;
+        QMetaObject::invokeMethod(this, [this, text, percent]() {
+            emit textLoaded(text, false);
+            emit progress(percent);
+        }, Qt::QueuedConnection);
+    }
+
+    if (cancelled.loadRelaxed()) {
+        return;
+    }
+
+    // Checking every byte has the last word on the encoding
+    if (encoding == EncodingManager::Encoding::Unknown) {
+        encoding = detection.encoding;  // Empty file
+    } else if (!detection.isCertain()) {
+        validator.finish();
+        if (validator.encoding() != encoding) {
+            encoding = validator.encoding();
+            const QString text = EncodingManager::decode(data, encoding);
+            QMetaObject::invokeMethod(this, [this, text]() { emit textLoaded(text, true); }, Qt::QueuedConnection);
+        }
+    }
+
+    QMetaObject::invokeMethod(this, [this, encoding]() {
+        fileEncoding = encoding;
+        emit progress(100);
+        emit finished();
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,57 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include "encodingmanager.h"
+
+/**
+ * @brief Reads and decodes a file on a worker thread
+ *
+ * The file is read in chunks, and each chunk is decoded up to its last line
+ * break and handed over with textLoaded() as soon as it is read. A small
+ * first chunk puts the start of the file on screen while the rest is still
+ * loading. The encoding is detected from the first chunk and the end of the
+ * file; unless that is certain, each chunk is checked as it is read, and
+ * should the whole file turn out to be in another encoding, the full text
+ * is handed over again with replace set.
+ *
+ * Deleting the loader cancels it; nothing is emitted after that.
+ */
+class FileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileLoader(const QString &fileName, QObject *parent = nullptr);
+    ~FileLoader() override;
+
+    void start();
+
+    QString fileName() const { return path; }
+
+    // Valid once finished() has been emitted
+    EncodingManager::Encoding encoding() const { return fileEncoding; }
+
+signals:
+    // Decoded text to append, or to replace everything handed over so far
+    void textLoaded(const QString &text, bool replace);
+    void progress(int percent);
+    void finished();
+    void failed(const QString &error);
+
+private slots:
+    void onWorkerFinished();
+
+private:
+    QString path;
+    EncodingManager::Encoding fileEncoding;
+    QThread *worker;
+    QAtomicInt cancelled;
+
+    void load();
+};
+
+#endif // FILELOADER_H
@@ -0,0 +1,134 @@
+#include "foldindex.h"
+#include "blockdata.h"
+#include "bracketindex.h"
+
+namespace {
+
+// ( [ { fold; < > does not
+const int FoldingKinds = 3;
+
+// Whether the bracket at column is the first thing on its line
+bool startsLine(const QTextBlock &block, int column)
+{
+    const QString text = block.text();
+    for (int i = 0; i < column && i < text.length(); ++i) {
+        if (!text.at(i).isSpace()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Fold end for a bracket closing at column of block (block number closingNumber)
+int bracketFoldEnd(const QTextBlock &closing, int closingNumber, int column)
+{
+    return startsLine(closing, column) ? closingNumber - 1 : closingNumber;
+}
+
+} // namespace
+
+FoldIndex::FoldIndex(const QTextDocument *document)
+    : document(document)
+{
+}
+
+int FoldIndex::foldEnd(int line) const
+{
+    const QVector<int> &all = foldEnds();
+    return line >= 0 && line < all.size() ? all.at(line) : -1;
+}
+
+const QVector<int> &FoldIndex::foldEnds() const
+{
+    // Highlighting can change brackets without a new revision, when a
+    // comment opened above reaches a block
+    if (revision != document->revision() || generation != BlockData::generation()) {
+        ends = scan(document);
+        revision = document->revision();
+        generation = BlockData::generation();  // After the scan refreshed stale blocks
+    }
+    return ends;
+}
+
+QVector<int> FoldIndex::scan(const QTextDocument *document)
+{
+    QVector<int> ends(document->blockCount(), -1);
+
+    // Open brackets per kind, matched the same way as BracketIndex::findMatch
+    struct OpenBracket {
+        int block;
+        int column;
+        bool folds;  // First bracket its line leaves open
+    };
+    QVector<OpenBracket> openBrackets[FoldingKinds];
+
+    // Lines whose indentation range is still open, shallowest first
+    struct OpenIndent {
+        int block;
+        int indent;
+        bool folds;  // Next non-blank line is indented deeper
+    };
+    QVector<OpenIndent> openIndents;
+
+    int number = 0;
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next(), ++number) {
+        const BlockData *data = BlockData::of(block);
+
+        for (const BlockData::Bracket &bracket : data->brackets) {
+            const int kind = BracketIndex::bracketKind(bracket.character);
+            if (kind >= FoldingKinds) {
+                continue;
+            }
+            QVector<OpenBracket> &open = openBrackets[kind];
+            if (BracketIndex::isOpeningBracket(bracket.character)) {
+                open.append({number, bracket.column, false});
+            } else if (!open.isEmpty()) {
+                const OpenBracket opener = open.takeLast();
+                if (opener.folds) {
+                    const int end = bracketFoldEnd(block, number, bracket.column);
+                    if (end > opener.block) {
+                        ends[opener.block] = end;
+                    }
+                }
+            }
+        }
+
+        // The outermost bracket this line leaves open decides its fold; the
+        // line's own openers are on top of the stacks
+        OpenBracket *first = nullptr;
+        for (QVector<OpenBracket> &open : openBrackets) {
+            for (int i = int(open.size()) - 1; i >= 0 && open.at(i).block == number; --i) {
+                if (!first || open.at(i).column < first->column) {
+                    first = &open[i];
+                }
+            }
+        }
+        if (first) {
+            first->folds = true;
+        }
+
+        const int indent = data->indent;
+        if (indent < 0) {
+            continue;
+        }
+        if (!openIndents.isEmpty() && indent > openIndents.last().indent) {
+            openIndents.last().folds = true;
+        }
+        while (!openIndents.isEmpty() && openIndents.last().indent >= indent) {
+            const OpenIndent start = openIndents.takeLast();
+            // A bracket range found earlier takes precedence
+            if (start.folds && ends.at(start.block) < 0) {
+                ends[start.block] = number - 1;
+            }
+        }
+        openIndents.append({number, indent, false});
+    }
+
+    for (const OpenIndent &start : std::as_const(openIndents)) {
+        if (start.folds && ends.at(start.block) < 0) {
+            ends[start.block] = number - 1;
+        }
+    }
+
+    return ends;
+}
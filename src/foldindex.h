@@ -0,0 +1,46 @@
+#ifndef FOLDINDEX_H
+#define FOLDINDEX_H
+
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QVector>
+
+/**
+ * @brief Fold ranges derived from the per-block data in BlockData
+ *
+ * A line folds to the bracket that closes the first (, [ or { it leaves
+ * open, and otherwise over the following lines that are indented deeper
+ * (blank lines included). Brackets in strings and comments do not count.
+ * A closing bracket that starts its line stays visible, so "} else {" and
+ * the last line of a block keep showing.
+ *
+ * Indentation and bracket lists are cached per block and refreshed only
+ * when a block changes, so none of the queries copy the document. The fold
+ * ends of all lines are found in one pass and kept until the text or a
+ * block's brackets change, so per-line queries are lookups.
+ */
+class FoldIndex
+{
+public:
+    explicit FoldIndex(const QTextDocument *document);
+
+    // Last line hidden by folding at line, or -1 if it does not fold
+    int foldEnd(int line) const;
+
+    // Whether a fold starts at line, cheap enough for every painted line
+    bool isFoldable(int line) const { return foldEnd(line) >= 0; }
+
+    // foldEnd() of every line, brought up to date if needed
+    const QVector<int> &foldEnds() const;
+
+    // foldEnd() of every block, in one pass over the document
+    static QVector<int> scan(const QTextDocument *document);
+
+private:
+    const QTextDocument *document;
+    mutable QVector<int> ends;
+    mutable int revision = -1;    // Document revision the ends were found for
+    mutable int generation = -1;  // BlockData::generation() they were found for
+};
+
+#endif // FOLDINDEX_H
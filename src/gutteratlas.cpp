@@ -0,0 +1,75 @@
+#include "gutteratlas.h"
+#include <QColor>
+#include <QFontMetrics>
+#include <QPolygon>
+#include <QtMath>
+
+namespace {
+
+const QColor NumberColor(105, 109, 121);   // --color-fg-secondary: #696D79
+const QColor BookmarkColor(66, 135, 245);
+
+// Transparent pixmap of logical size width x height for devicePixelRatio
+QPixmap blankPixmap(int width, int height, qreal devicePixelRatio)
+{
+    QPixmap pixmap(qCeil(width * devicePixelRatio), qCeil(height * devicePixelRatio));
+    pixmap.setDevicePixelRatio(devicePixelRatio);
+    pixmap.fill(Qt::transparent);
+    return pixmap;
+}
+
+QPixmap trianglePixmap(const QPolygon &triangle, qreal devicePixelRatio)
+{
+    QPixmap pixmap = blankPixmap(GutterAtlas::IconSize, GutterAtlas::IconSize, devicePixelRatio);
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setBrush(NumberColor);
+    painter.setPen(Qt::NoPen);
+    painter.drawPolygon(triangle);
+    return pixmap;
+}
+
+} // namespace
+
+void GutterAtlas::prepare(const QFont &font, qreal devicePixelRatio)
+{
+    if (cachedRatio == devicePixelRatio && cachedFont == font) {
+        return;
+    }
+    cachedFont = font;
+    cachedRatio = devicePixelRatio;
+
+    const QFontMetrics metrics(font);
+    digitAdvance = metrics.horizontalAdvance(QLatin1Char('9'));
+    for (int digit = 0; digit < 10; ++digit) {
+        digits[digit] = blankPixmap(digitAdvance, metrics.height(), devicePixelRatio);
+        QPainter painter(&digits[digit]);
+        painter.setFont(font);
+        painter.setPen(NumberColor);
+        painter.drawText(0, metrics.ascent(), QString(QChar('0' + digit)));
+    }
+
+    const int size = IconSize;
+    // Right-pointing triangle for a folded line, down-pointing for an open one
+    collapsedIcon = trianglePixmap(QPolygon({QPoint(0, 0), QPoint(0, size), QPoint(size, size / 2)}),
+                                   devicePixelRatio);
+    expandedIcon = trianglePixmap(QPolygon({QPoint(0, 0), QPoint(size, 0), QPoint(size / 2, size)}),
+                                  devicePixelRatio);
+
+    bookmark = blankPixmap(size, size, devicePixelRatio);
+    QPainter painter(&bookmark);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setBrush(BookmarkColor);
+    painter.setPen(Qt::NoPen);
+    painter.drawEllipse(0, 0, size, size);
+}
+
+void GutterAtlas::drawNumber(QPainter &painter, int right, int top, int number) const
+{
+    int x = right;
+    do {
+        x -= digitAdvance;
+        painter.drawPixmap(x, top, digits[number % 10]);
+        number /= 10;
+    } while (number > 0);
+}
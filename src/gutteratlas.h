@@ -0,0 +1,44 @@
+#ifndef GUTTERATLAS_H
+#define GUTTERATLAS_H
+
+#include <QFont>
+#include <QPainter>
+#include <QPixmap>
+
+/**
+ * @brief Pre-rendered line number digits and gutter icons
+ *
+ * The gutter repaints every exposed line, so it draws numbers digit by digit
+ * from cached pixmaps instead of shaping a string per line, and blits the
+ * fold and bookmark icons instead of building polygons. The pixmaps are
+ * rendered for one font and device pixel ratio and rebuilt when either
+ * changes.
+ */
+class GutterAtlas
+{
+public:
+    static const int IconSize = 8;
+
+    // Render the pixmaps unless they already match font and devicePixelRatio
+    void prepare(const QFont &font, qreal devicePixelRatio);
+
+    // Width of one digit; numbers are drawn with fixed-width digits
+    int digitWidth() const { return digitAdvance; }
+
+    // Draw number so that its last digit ends at x = right
+    void drawNumber(QPainter &painter, int right, int top, int number) const;
+
+    const QPixmap &foldIcon(bool folded) const { return folded ? collapsedIcon : expandedIcon; }
+    const QPixmap &bookmarkIcon() const { return bookmark; }
+
+private:
+    QFont cachedFont;
+    qreal cachedRatio = 0;
+    int digitAdvance = 0;
+    QPixmap digits[10];
+    QPixmap collapsedIcon;
+    QPixmap expandedIcon;
+    QPixmap bookmark;
+};
+
+#endif // GUTTERATLAS_H
@@ -1,42 +1,95 @@
 #include "jsonsyntaxhighlighter.h"
+#include "languageregistry.h"
+#include "blockdata.h"
+#include <QTextLayout>
+#include <QElapsedTimer>
 #include <QDebug>
+#include <limits>
+
+namespace {
+
+// Time budget of one idle highlighting chunk, short enough not to drop a frame
+const int IdleChunkMs = 8;
+
+// Blocks treated as visible until the editor reports its viewport
+const int DefaultVisibleBlocks = 100;
+
+// Pending ranges at least this long are tokenized on a worker thread
+const int BackgroundMinBlocks = 2000;
+
+// Blocks per batch handed from the worker to the GUI thread
+const int BackgroundBatchBlocks = 500;
+
+// How far the worker may run ahead of the blocks applied so far
+const int BackgroundMaxAhead = 20000;
+
+// Quiet time after an edit before a new snapshot is taken
+const int EditSettleMs = 300;
+
+// Category of comment spans in background results
+const int CommentRun = -1;
+
+// Upper bound on queued ranges; beyond it the two closest ranges are merged
+const int MaxDirtyRanges = 32;
+
+// Value of stateValidUntil when every block's state is up to date
+const int AllStatesValid = std::numeric_limits<int>::max();
+
+} // namespace
 
 JsonSyntaxHighlighter::JsonSyntaxHighlighter(QTextDocument *parent)
-    : QSyntaxHighlighter(parent), useDarkTheme(false)
+    : QSyntaxHighlighter(parent), useDarkTheme(false),
+      lazyHighlighting(false), visibleFirst(0), visibleLast(DefaultVisibleBlocks - 1),
+      stateValidUntil(AllStatesValid), fillingBlock(-1), fullRehighlight(false),
+      worker(nullptr), workerFirstBlock(-1), workerLastBlock(-1), workerGeneration(-1), appliedBlock(-1),
+      editGeneration(0), applyingHighlight(false), applyingBatch(nullptr), applyingIndex(0)
 {
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(0);
+    connect(idleTimer, &QTimer::timeout, this, &JsonSyntaxHighlighter::highlightIdleChunk);
+
+    if (parent) {
+        connect(parent, &QTextDocument::contentsChange, this, &JsonSyntaxHighlighter::onContentsChange);
+    }
 }
 
-bool JsonSyntaxHighlighter::loadLanguages(const QString &languagesDir)
+JsonSyntaxHighlighter::~JsonSyntaxHighlighter()
 {
-    bool success = languageLoader.loadLanguages(languagesDir);
-    if (success) {
-        qDebug() << "Loaded languages:" << languageLoader.getAvailableLanguages();
+    workerGeneration.storeRelaxed(-1);
+    if (worker) {
+        worker->wait();
+        delete worker;
     }
-    return success;
+}
+
+bool JsonSyntaxHighlighter::loadLanguages(const QString &languagesDir)
+{
+    return LanguageRegistry::instance().ensureLoaded(languagesDir);
 }
 
 QStringList JsonSyntaxHighlighter::getAvailableLanguages() const
 {
-    return languageLoader.getAvailableLanguages();
+    return LanguageRegistry::instance().getAvailableLanguages();
 }
 
 void JsonSyntaxHighlighter::setLanguage(const QString &languageName)
 {
     if (languageName.isEmpty() || languageName.toLower() == "none") {
         currentLanguageName.clear();
-        currentLanguage = LanguageDefinition();
-        highlightingRules.clear();
-        rehighlight();
+        currentLanguage.reset();
+        highlightingRules.reset();
+        rehighlightDocument();
         return;
     }
 
-    LanguageDefinition langDef = languageLoader.getLanguageDefinition(languageName);
-    if (langDef.isValid()) {
+    QSharedPointer<const LanguageDefinition> langDef = LanguageRegistry::instance().getLanguageDefinition(languageName);
+    if (langDef) {
         currentLanguageName = languageName;
         currentLanguage = langDef;
         updateHighlightingRules();
-        rehighlight();
-        qDebug() << "Set language to:" << langDef.displayName;
+        rehighlightDocument();
+        qDebug() << "Set language to:" << langDef->displayName;
     } else {
         qWarning() << "Language not found:" << languageName;
     }
@@ -44,7 +97,7 @@ void JsonSyntaxHighlighter::setLanguage(const QString &languageName)
 
 void JsonSyntaxHighlighter::setLanguageFromFilename(const QString &filename)
 {
-    QString detectedLanguage = languageLoader.detectLanguageFromExtension(filename);
+    QString detectedLanguage = LanguageRegistry::instance().detectLanguageFromExtension(filename);
     if (!detectedLanguage.isEmpty()) {
         setLanguage(detectedLanguage);
         qDebug() << "Auto-detected language" << detectedLanguage << "for file:" << filename;
@@ -61,77 +114,543 @@ QString JsonSyntaxHighlighter::getCurrentLanguage() const
 
 void JsonSyntaxHighlighter::updateHighlightingRules()
 {
-    highlightingRules = languageLoader.createHighlightingRules(currentLanguage, useDarkTheme);
-    qDebug() << "Created" << highlightingRules.size() << "highlighting rules for" << currentLanguage.displayName
-             << "(dark theme:" << useDarkTheme << ")";
+    highlightingRules = LanguageRegistry::instance().getHighlightingRules(currentLanguage->name, useDarkTheme);
 }
 
 void JsonSyntaxHighlighter::setTheme(bool isDark)
 {
     if (useDarkTheme != isDark) {
         useDarkTheme = isDark;
-        if (currentLanguage.isValid()) {
+        if (currentLanguage) {
             updateHighlightingRules();
-            rehighlight();
+            rehighlightDocument();
+        }
+    }
+}
+
+void JsonSyntaxHighlighter::setLazyHighlighting(bool enable)
+{
+    if (lazyHighlighting == enable) {
+        return;
+    }
+
+    lazyHighlighting = enable;
+    if (!enable && hasPendingBlocks()) {
+        // Finish the document the usual way
+        rehighlightDocument();
+    }
+}
+
+void JsonSyntaxHighlighter::setVisibleBlockRange(int firstBlock, int lastBlock)
+{
+    visibleFirst = qMax(0, firstBlock);
+    visibleLast = qMax(visibleFirst, lastBlock);
+    highlightVisibleBlocks();
+}
+
+void JsonSyntaxHighlighter::rehighlightDocument()
+{
+    // Results computed with the previous rules are of no use any more
+    cancelBackgroundPass();
+    dirtyRanges.clear();
+
+    QTextDocument *doc = document();
+    if (!lazyHighlighting || !highlightingRules || !doc) {
+        idleTimer->stop();
+        applyingHighlight = true;
+        fullRehighlight = true;
+        rehighlight();
+        fullRehighlight = false;
+        applyingHighlight = false;
+        stateValidUntil = AllStatesValid;
+        return;
+    }
+
+    // Everything needs highlighting: do what is on screen now, the rest when idle
+    dirtyRanges.append({0, doc->blockCount() - 1});
+    stateValidUntil = 0;
+    highlightVisibleBlocks();
+    idleTimer->start();
+}
+
+void JsonSyntaxHighlighter::highlightVisibleBlocks()
+{
+    QTextDocument *doc = document();
+    if (!doc || nextDirtyBlock(visibleFirst - 1) > visibleLast) {
+        return;
+    }
+
+    // Comment state flows down from the top of the document, so bring the
+    // states above the viewport up to date first without formatting anything
+    if (stateValidUntil < visibleFirst) {
+        propagateCommentStates(stateValidUntil, visibleFirst);
+    }
+
+    applyingHighlight = true;
+    for (int number = nextDirtyBlock(visibleFirst - 1); number <= visibleLast; number = nextDirtyBlock(number)) {
+        QTextBlock block = doc->findBlockByNumber(number);
+        if (!block.isValid()) {
+            break;
+        }
+        highlightQueuedBlock(block);
+    }
+    applyingHighlight = false;
+}
+
+void JsonSyntaxHighlighter::highlightQueuedBlock(const QTextBlock &block)
+{
+    // highlightBlock() takes the block off the queue; a changed end state
+    // queues the next one
+    fillingBlock = block.blockNumber();
+    rehighlightBlock(block);
+    fillingBlock = -1;
+}
+
+void JsonSyntaxHighlighter::highlightIdleChunk()
+{
+    QTextDocument *doc = document();
+    if (!doc) {
+        return;
+    }
+
+    // Hand a long range to a worker thread once typing has settled
+    if (!worker && readyBatches.isEmpty() && hasPendingBlocks()) {
+        const DirtyRange range = dirtyRanges.first();
+        if (range.last - range.first >= BackgroundMinBlocks && stateValidUntil >= range.first &&
+            (!sinceLastEdit.isValid() || sinceLastEdit.hasExpired(EditSettleMs))) {
+            startBackgroundPass(range.first, range.last);
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    bool waitingForWorker = false;
+    applyingHighlight = true;
+
+    while (hasPendingBlocks() && !timer.hasExpired(IdleChunkMs)) {
+        // Queued blocks on screen go first, then the queue in document order
+        int number = nextDirtyBlock(visibleFirst - 1);
+        const bool visible = number <= visibleLast;
+        if (!visible) {
+            number = dirtyRanges.first().first;
+        }
+
+        QTextBlock block = doc->findBlockByNumber(number);
+        if (!block.isValid()) {
+            markClean(number);
+            continue;
+        }
+
+        const BackgroundBatch *batch = nullptr;
+        for (const BackgroundBatch &ready : readyBatches) {
+            if (number >= ready.firstBlock && number < ready.firstBlock + ready.states.size()) {
+                batch = &ready;
+                break;
+            }
+        }
+
+        if (!batch && !visible && worker && workerGeneration.loadRelaxed() == editGeneration &&
+            number >= workerFirstBlock && number <= workerLastBlock) {
+            // The worker has not got this far yet; its next batch restarts the timer
+            waitingForWorker = true;
+            break;
+        }
+
+        if (!batch && stateValidUntil < number) {
+            propagateCommentStates(stateValidUntil, number);
+        }
+
+        applyingBatch = batch;
+        applyingIndex = batch ? number - batch->firstBlock : 0;
+        highlightQueuedBlock(block);
+        applyingBatch = nullptr;
+    }
+
+    // Batches behind the front of the queue have been applied
+    const int front = hasPendingBlocks() ? dirtyRanges.first().first : AllStatesValid;
+    while (!readyBatches.isEmpty() && readyBatches.first().firstBlock + readyBatches.first().states.size() <= front) {
+        readyBatches.removeFirst();
+    }
+    appliedBlock.storeRelaxed(front == AllStatesValid ? workerLastBlock : front - 1);
+
+    applyingHighlight = false;
+    if (hasPendingBlocks() && !waitingForWorker) {
+        idleTimer->start();
+    }
+}
+
+void JsonSyntaxHighlighter::onContentsChange(int /* position */, int /* charsRemoved */, int /* charsAdded */)
+{
+    // The text changed: background results no longer line up with the blocks
+    if (!applyingHighlight) {
+        sinceLastEdit.restart();
+        cancelBackgroundPass();
+    }
+}
+
+void JsonSyntaxHighlighter::syncLineStates(int editBlock)
+{
+    // Called from the first highlightBlock() after lines were inserted or
+    // removed. QSyntaxHighlighter starts reformatting at the edited block, so
+    // the lines came or went right below editBlock.
+    const int blockCount = document()->blockCount();
+    const int delta = blockCount - int(lineStates.size());
+    const int position = qMin(editBlock + 1, int(lineStates.size()));
+
+    if (delta > 0) {
+        lineStates.insert(position, delta, -1);
+    } else {
+        lineStates.remove(position, qMin(-delta, int(lineStates.size()) - position));
+    }
+    lineStates.resize(blockCount);
+
+    // Queued blocks below the edit move with their lines
+    QVector<DirtyRange> shifted;
+    for (DirtyRange range : std::as_const(dirtyRanges)) {
+        if (range.first > editBlock) {
+            range.first = qMax(editBlock + 1, range.first + delta);
+        }
+        if (range.last > editBlock) {
+            range.last = qMax(range.first, range.last + delta);
+        }
+        range.last = qMin(range.last, blockCount - 1);
+        if (range.first > range.last) {
+            continue;
+        }
+        if (!shifted.isEmpty() && range.first <= shifted.last().last + 1) {
+            shifted.last().last = qMax(shifted.last().last, range.last);
+        } else {
+            shifted.append(range);
+        }
+    }
+    dirtyRanges = shifted;
+
+    if (stateValidUntil != AllStatesValid && stateValidUntil > editBlock) {
+        stateValidUntil = qMax(editBlock + 1, stateValidUntil + delta);
+    }
+}
+
+bool JsonSyntaxHighlighter::isDirty(int blockNumber) const
+{
+    for (const DirtyRange &range : dirtyRanges) {
+        if (blockNumber < range.first) {
+            return false;
+        }
+        if (blockNumber <= range.last) {
+            return true;
         }
     }
+    return false;
+}
+
+void JsonSyntaxHighlighter::markDirty(int blockNumber)
+{
+    int i = 0;
+    while (i < dirtyRanges.size() && dirtyRanges.at(i).last < blockNumber - 1) {
+        ++i;
+    }
+
+    if (i < dirtyRanges.size() && dirtyRanges.at(i).first <= blockNumber + 1) {
+        // Inside or next to an existing range
+        DirtyRange &range = dirtyRanges[i];
+        range.first = qMin(range.first, blockNumber);
+        range.last = qMax(range.last, blockNumber);
+        if (i + 1 < dirtyRanges.size() && dirtyRanges.at(i + 1).first <= range.last + 1) {
+            range.last = qMax(range.last, dirtyRanges.at(i + 1).last);
+            dirtyRanges.remove(i + 1);
+        }
+    } else {
+        dirtyRanges.insert(i, {blockNumber, blockNumber});
+    }
+
+    // Keep the queue bounded by folding the two closest ranges together
+    if (dirtyRanges.size() > MaxDirtyRanges) {
+        int closest = 0;
+        for (int j = 1; j + 1 < dirtyRanges.size(); ++j) {
+            if (dirtyRanges.at(j + 1).first - dirtyRanges.at(j).last <
+                dirtyRanges.at(closest + 1).first - dirtyRanges.at(closest).last) {
+                closest = j;
+            }
+        }
+        dirtyRanges[closest].last = dirtyRanges.at(closest + 1).last;
+        dirtyRanges.remove(closest + 1);
+    }
+
+    stateValidUntil = qMin(stateValidUntil, blockNumber);
+
+    if (!idleTimer->isActive()) {
+        idleTimer->start();
+    }
+}
+
+void JsonSyntaxHighlighter::markClean(int blockNumber)
+{
+    for (int i = 0; i < dirtyRanges.size(); ++i) {
+        DirtyRange &range = dirtyRanges[i];
+        if (blockNumber < range.first) {
+            return;
+        }
+        if (blockNumber > range.last) {
+            continue;
+        }
+
+        if (range.first == range.last) {
+            dirtyRanges.remove(i);
+        } else if (blockNumber == range.first) {
+            ++range.first;
+        } else if (blockNumber == range.last) {
+            --range.last;
+        } else {
+            DirtyRange tail = {blockNumber + 1, range.last};
+            range.last = blockNumber - 1;
+            dirtyRanges.insert(i + 1, tail);
+        }
+        return;
+    }
+}
+
+int JsonSyntaxHighlighter::nextDirtyBlock(int afterBlock) const
+{
+    for (const DirtyRange &range : dirtyRanges) {
+        if (range.last > afterBlock) {
+            return qMax(range.first, afterBlock + 1);
+        }
+    }
+    return AllStatesValid;
 }
 
 void JsonSyntaxHighlighter::highlightBlock(const QString &text)
 {
-    // Apply all highlighting rules
-    for (const HighlightingRule &rule : highlightingRules) {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-        while (matchIterator.hasNext()) {
-            QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+    const QTextBlock block = currentBlock();
+    const int number = block.blockNumber();
+    if (lineStates.size() != document()->blockCount()) {
+        syncLineStates(number);
+    }
+
+    // Blocks reached by an edit's cascade below the viewport (or anywhere
+    // offscreen in lazy mode) are queued instead of highlighted now. They keep
+    // their formats and state until then; the unchanged state also stops
+    // QSyntaxHighlighter from walking on to the next block.
+    if (highlightingRules && !fullRehighlight && number != fillingBlock &&
+        (number > visibleLast || (lazyHighlighting && number < visibleFirst))) {
+        const QList<QTextLayout::FormatRange> previousFormats = block.layout()->formats();
+        for (const QTextLayout::FormatRange &range : previousFormats) {
+            setFormat(range.start, range.length, range.format);
+        }
+        markDirty(number);
+        return;
+    }
+
+    opaqueSpans.clear();
+    if (number == fillingBlock && applyingBatch) {
+        applyBackgroundResult();
+    } else {
+        // Tokenize the line in a single pass and apply the resulting runs
+        if (highlightingRules) {
+            highlightingRules->tokenizer->tokenize(text, tokenRuns);
+            for (const TokenRun &run : tokenRuns) {
+                setFormat(run.start, run.length, highlightingRules->formats.at(run.category));
+                if (highlightingRules->opaqueCategories.at(run.category)) {
+                    opaqueSpans.append(run);
+                }
+            }
+        }
+
+        // Handle multiline comments if defined
+        highlightMultilineComments(text);
+    }
+
+    // Brackets in strings and comments do not take part in matching or folding
+    BlockData::update(block, text, opaqueSpans);
+
+    lineStates[number] = currentBlockState();
+    if (!dirtyRanges.isEmpty()) {
+        markClean(number);
+    }
+    if (number == stateValidUntil) {
+        stateValidUntil = nextDirtyBlock(number);
+    }
+}
+
+void JsonSyntaxHighlighter::propagateCommentStates(int fromBlock, int toBlock)
+{
+    toBlock = qMin(toBlock, int(lineStates.size()));
+    if (fromBlock >= toBlock) {
+        return;
+    }
+    if (!highlightingRules || highlightingRules->comments.isEmpty()) {
+        stateValidUntil = qMax(stateValidUntil, toBlock);
+        return;
+    }
+
+    // A block whose input state changes has stale formats: queue it
+    int state = fromBlock > 0 ? lineStates.at(fromBlock - 1) : -1;
+    bool inputChanged = false;
+    QTextBlock block = document()->findBlockByNumber(fromBlock);
+    for (int number = fromBlock; number < toBlock && block.isValid(); ++number, block = block.next()) {
+        if (inputChanged && !isDirty(number)) {
+            markDirty(number);
         }
+        state = highlightingRules->comments.scan(block.text(), state, nullptr);
+        inputChanged = state != lineStates.at(number);
+        lineStates[number] = state;
+        block.setUserState(state);
     }
 
-    // Handle multiline comments if defined
-    highlightMultilineComments(text);
+    if (inputChanged && toBlock < lineStates.size() && !isDirty(toBlock)) {
+        markDirty(toBlock);
+    }
+    stateValidUntil = inputChanged ? toBlock : nextDirtyBlock(toBlock - 1);
 }
 
 void JsonSyntaxHighlighter::highlightMultilineComments(const QString &text)
 {
-    if (currentLanguage.multilineCommentStart.isEmpty() || currentLanguage.multilineCommentEnd.isEmpty()) {
+    if (!highlightingRules || highlightingRules->comments.isEmpty()) {
         return;
     }
 
-    // Create format for multiline comments
-    QTextCharFormat multiLineCommentFormat;
-    const QMap<QString, QString> &colorMap = useDarkTheme ? currentLanguage.darkColors : currentLanguage.colors;
-    QString commentColor = colorMap.value("comments", useDarkTheme ? "#6A9955" : "#008000");
-    multiLineCommentFormat.setForeground(QColor(commentColor));
+    // Delimiters, state machine and format are prepared once per rule set
+    setCurrentBlockState(highlightingRules->comments.scan(text, previousBlockState(), &commentSpans));
+    for (const TokenRun &span : commentSpans) {
+        setFormat(span.start, span.length, highlightingRules->commentFormat);
+    }
+    opaqueSpans += commentSpans;
+}
+
+void JsonSyntaxHighlighter::startBackgroundPass(int firstBlock, int lastBlock)
+{
+    const int startState = firstBlock > 0 ? lineStates.at(firstBlock - 1) : -1;
+    const int generation = editGeneration;
 
-    LanguageStyle commentStyle = currentLanguage.styles.value("comments");
-    if (commentStyle.bold) {
-        multiLineCommentFormat.setFontWeight(QFont::Bold);
+    // One contiguous copy of the text, blocks separated by U+2029
+    const QString snapshot = document()->toRawText();
+    const QSharedPointer<const HighlightingRuleSet> rules = highlightingRules;
+
+    workerFirstBlock = firstBlock;
+    workerLastBlock = lastBlock;
+    workerGeneration.storeRelaxed(generation);
+    appliedBlock.storeRelaxed(firstBlock - 1);
+
+    worker = QThread::create([this, snapshot, rules, firstBlock, lastBlock, startState, generation]() {
+        tokenizeInBackground(snapshot, rules, firstBlock, lastBlock, startState, generation);
+    });
+    connect(worker, &QThread::finished, this, &JsonSyntaxHighlighter::onWorkerFinished);
+    worker->start(QThread::LowPriority);
+}
+
+void JsonSyntaxHighlighter::cancelBackgroundPass()
+{
+    ++editGeneration;
+    workerGeneration.storeRelaxed(-1);
+    readyBatches.clear();
+}
+
+void JsonSyntaxHighlighter::onWorkerFinished()
+{
+    if (worker) {
+        worker->deleteLater();
+        worker = nullptr;
     }
-    if (commentStyle.italic) {
-        multiLineCommentFormat.setFontItalic(true);
+
+    if (hasPendingBlocks() && !idleTimer->isActive()) {
+        idleTimer->start();
     }
+}
 
-    setCurrentBlockState(0);
+void JsonSyntaxHighlighter::receiveBatch(const BackgroundBatch &batch)
+{
+    if (batch.generation != editGeneration) {
+        return;
+    }
 
-    QRegularExpression startExpression(QRegularExpression::escape(currentLanguage.multilineCommentStart));
-    QRegularExpression endExpression(QRegularExpression::escape(currentLanguage.multilineCommentEnd));
+    readyBatches.append(batch);
+    if (hasPendingBlocks() && !idleTimer->isActive()) {
+        idleTimer->start();
+    }
+}
 
-    int startIndex = 0;
-    if (previousBlockState() != 1)
-        startIndex = text.indexOf(startExpression);
+void JsonSyntaxHighlighter::applyBackgroundResult()
+{
+    const int begin = applyingIndex > 0 ? applyingBatch->runEnds.at(applyingIndex - 1) : 0;
+    const int end = applyingBatch->runEnds.at(applyingIndex);
 
-    while (startIndex >= 0) {
-        QRegularExpressionMatch endMatch = endExpression.match(text, startIndex);
-        int endIndex = endMatch.capturedStart();
-        int commentLength = 0;
-        if (endIndex == -1) {
-            setCurrentBlockState(1);
-            commentLength = text.length() - startIndex;
-        } else {
-            commentLength = endIndex - startIndex + endMatch.capturedLength();
+    for (int i = begin; i < end; ++i) {
+        const TokenRun &run = applyingBatch->runs.at(i);
+        const bool comment = run.category == CommentRun;
+        setFormat(run.start, run.length, comment ? highlightingRules->commentFormat : highlightingRules->formats.at(run.category));
+        if (comment || highlightingRules->opaqueCategories.at(run.category)) {
+            opaqueSpans.append(run);
+        }
+    }
+
+    if (!highlightingRules->comments.isEmpty()) {
+        setCurrentBlockState(applyingBatch->states.at(applyingIndex));
+    }
+}
+
+// Runs on the worker thread: touches nothing but its arguments and the atomics
+void JsonSyntaxHighlighter::tokenizeInBackground(const QString &snapshot, QSharedPointer<const HighlightingRuleSet> rules,
+                                                 int firstBlock, int lastBlock, int startState, int generation)
+{
+    const QChar separator = QChar::ParagraphSeparator;
+    const bool hasComments = !rules->comments.isEmpty();
+
+    int pos = 0;
+    for (int block = 0; block < firstBlock; ++block) {
+        pos = int(snapshot.indexOf(separator, pos));
+        if (pos < 0) {
+            return;
+        }
+        ++pos;
+    }
+
+    QVector<TokenRun> runs;
+    QVector<TokenRun> spans;
+    BackgroundBatch batch;
+    batch.generation = generation;
+    batch.firstBlock = firstBlock;
+    int state = startState;
+
+    for (int block = firstBlock; block <= lastBlock; ++block) {
+        // Stay a bounded distance ahead of the blocks the GUI thread has applied
+        while (block - appliedBlock.loadRelaxed() > BackgroundMaxAhead) {
+            if (workerGeneration.loadRelaxed() != generation) {
+                return;
+            }
+            QThread::msleep(5);
+        }
+        if (workerGeneration.loadRelaxed() != generation) {
+            return;
+        }
+
+        int end = int(snapshot.indexOf(separator, pos));
+        const bool lastInText = end < 0;
+        if (lastInText) {
+            end = int(snapshot.size());
+        }
+        const QString line = QString::fromRawData(snapshot.constData() + pos, end - pos);
+
+        rules->tokenizer->tokenize(line, runs);
+        batch.runs += runs;
+        if (hasComments) {
+            state = rules->comments.scan(line, state, &spans);
+            for (const TokenRun &span : spans) {
+                batch.runs.append({span.start, span.length, CommentRun});
+            }
+        }
+        batch.runEnds.append(batch.runs.size());
+        batch.states.append(state);
+
+        if (batch.states.size() == BackgroundBatchBlocks || lastInText || block == lastBlock) {
+            QMetaObject::invokeMethod(this, [this, batch]() { receiveBatch(batch); }, Qt::QueuedConnection);
+            batch = BackgroundBatch();
+            batch.generation = generation;
+            batch.firstBlock = block + 1;
         }
-        setFormat(startIndex, commentLength, multiLineCommentFormat);
-        startIndex = text.indexOf(startExpression, startIndex + commentLength);
+
+        if (lastInText) {
+            return;
+        }
+        pos = end + 1;
     }
-}
\ No newline at end of file
+}
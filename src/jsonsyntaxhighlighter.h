@@ -5,6 +5,14 @@
 #include <QTextDocument>
 #include <QRegularExpression>
 #include <QTextCharFormat>
+#include <QVector>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QTextBlock>
+#include <QThread>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QList>
 #include "languageloader.h"
 
 class JsonSyntaxHighlighter : public QSyntaxHighlighter
@@ -13,8 +21,9 @@ class JsonSyntaxHighlighter : public QSyntaxHighlighter
 
 public:
     explicit JsonSyntaxHighlighter(QTextDocument *parent = nullptr);
+    ~JsonSyntaxHighlighter() override;
 
-    // Load available languages
+    // Load available languages into the shared registry (only reads files once)
     bool loadLanguages(const QString &languagesDir = "languages");
 
     // Get list of available languages
@@ -35,18 +44,98 @@ public:
     // Get current theme
     bool isDarkTheme() const { return useDarkTheme; }
 
+    // Lazy mode highlights the visible blocks right away and the rest of the
+    // document in short idle-time chunks, so large files stay responsive
+    void setLazyHighlighting(bool enable);
+    bool isLazyHighlighting() const { return lazyHighlighting; }
+
+    // Blocks currently on screen; these are highlighted first. Edits that
+    // change the state of offscreen blocks queue them instead of
+    // rehighlighting the rest of the document on the spot.
+    void setVisibleBlockRange(int firstBlock, int lastBlock);
+
+    // True while blocks are queued for highlighting
+    bool hasPendingBlocks() const { return !dirtyRanges.isEmpty(); }
+
+    // True while a worker thread is tokenizing a snapshot of the document
+    bool isTokenizingInBackground() const { return worker != nullptr; }
+
 protected:
     void highlightBlock(const QString &text) override;
 
+private slots:
+    void highlightIdleChunk();
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void onWorkerFinished();
+
 private:
-    LanguageLoader languageLoader;
     QString currentLanguageName;
-    LanguageDefinition currentLanguage;
-    QVector<HighlightingRule> highlightingRules;
+    QSharedPointer<const LanguageDefinition> currentLanguage;
+    QSharedPointer<const HighlightingRuleSet> highlightingRules;
+    QVector<TokenRun> tokenRuns;     // Reused between blocks
+    QVector<TokenRun> commentSpans;  // Reused between blocks
+    QVector<TokenRun> opaqueSpans;   // Strings and comments of the current block, for BlockData
     bool useDarkTheme;
 
+    // Blocks waiting to be highlighted, by block number
+    struct DirtyRange {
+        int first;
+        int last;
+    };
+
+    // Deferred highlighting state, kept in step with line insertions and
+    // removals by syncLineStates()
+    bool lazyHighlighting;
+    int visibleFirst;
+    int visibleLast;
+    QVector<int> lineStates;          // End state of every block when it was last highlighted
+    QVector<DirtyRange> dirtyRanges;  // Sorted, disjoint and bounded in number
+    int stateValidUntil;              // Blocks before this one have up-to-date end states
+    int fillingBlock;                 // Block the idle pass is highlighting
+    bool fullRehighlight;             // Set while the whole document is highlighted at once
+    QTimer *idleTimer;
+
+    // Formats of consecutive blocks computed by the worker thread
+    struct BackgroundBatch {
+        int generation = 0;
+        int firstBlock = 0;
+        QVector<TokenRun> runs;  // Token runs then comment spans, block after block
+        QVector<int> runEnds;    // End of each block's runs in runs
+        QVector<int> states;     // Block state after each block
+    };
+
+    // Background tokenization. The worker only reads its own snapshot of the
+    // text and the shared rule set; results are applied on the GUI thread and
+    // dropped if the text changed since the snapshot was taken.
+    QThread *worker;
+    int workerFirstBlock;
+    int workerLastBlock;
+    QAtomicInt workerGeneration;  // Generation the worker produces for, -1 cancels it
+    QAtomicInt appliedBlock;      // Last block applied from the worker's results
+    int editGeneration;           // Bumped whenever the text changes
+    bool applyingHighlight;       // Set while the highlighter itself reformats blocks
+    QElapsedTimer sinceLastEdit;
+    QList<BackgroundBatch> readyBatches;
+    const BackgroundBatch *applyingBatch;
+    int applyingIndex;
+
     void updateHighlightingRules();
+    void rehighlightDocument();
+    void highlightVisibleBlocks();
+    void highlightQueuedBlock(const QTextBlock &block);
+    void syncLineStates(int editBlock);
+    bool isDirty(int blockNumber) const;
+    void markDirty(int blockNumber);
+    void markClean(int blockNumber);
+    int nextDirtyBlock(int afterBlock) const;
+    void propagateCommentStates(int fromBlock, int toBlock);
     void highlightMultilineComments(const QString &text);
+    void startBackgroundPass(int firstBlock, int lastBlock);
+    void cancelBackgroundPass();
+    void receiveBatch(const BackgroundBatch &batch);
+    void applyBackgroundResult();
+    void tokenizeInBackground(const QString &snapshot, QSharedPointer<const HighlightingRuleSet> rules,
+                              int firstBlock, int lastBlock, int startState, int generation);
 };
 
 #endif // JSONSYNTAXHIGHLIGHTER_H
\ No newline at end of file
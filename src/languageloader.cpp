@@ -1,84 +1,47 @@
 #include "languageloader.h"
-#include <QDir>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QFile>
 #include <QDebug>
-#include <QFileInfo>
 #include <QColor>
 
 LanguageLoader::LanguageLoader()
 {
 }
 
-bool LanguageLoader::loadLanguages(const QString &languagesDir)
-{
-    languages.clear();
-
-    QDir dir(languagesDir);
-    if (!dir.exists()) {
-        qWarning() << "Languages directory does not exist:" << languagesDir;
-        return false;
-    }
-
-    QStringList jsonFiles = dir.entryList(QStringList() << "*.json", QDir::Files);
-
-    if (jsonFiles.isEmpty()) {
-        qWarning() << "No JSON language files found in:" << languagesDir;
-        return false;
-    }
-
-    for (const QString &fileName : jsonFiles) {
-        QString filePath = dir.absoluteFilePath(fileName);
-        LanguageDefinition langDef = loadLanguageFromFile(filePath);
-
-        if (langDef.isValid()) {
-            languages[langDef.name.toLower()] = langDef;
-            qDebug() << "Loaded language:" << langDef.displayName;
-        } else {
-            qWarning() << "Failed to load language from:" << fileName;
-        }
-    }
-
-    return !languages.isEmpty();
-}
-
-QStringList LanguageLoader::getAvailableLanguages() const
-{
-    QStringList result;
-    for (auto it = languages.begin(); it != languages.end(); ++it) {
-        result << it.value().displayName;
-    }
-    result.sort();
-    return result;
-}
+int LanguageLoader::filesRead = 0;
 
-LanguageDefinition LanguageLoader::getLanguageDefinition(const QString &languageName) const
+int LanguageLoader::fileReadCount()
 {
-    return languages.value(languageName.toLower());
+    return filesRead;
 }
 
-LanguageDefinition LanguageLoader::loadLanguageFromFile(const QString &filePath) const
+QJsonObject LanguageLoader::readLanguageFile(const QString &filePath)
 {
-    LanguageDefinition langDef;
-
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
         qWarning() << "Cannot open language file:" << filePath;
-        return langDef;
+        return QJsonObject();
     }
 
+    ++filesRead;
+
     QByteArray data = file.readAll();
     QJsonParseError error;
     QJsonDocument doc = QJsonDocument::fromJson(data, &error);
 
     if (error.error != QJsonParseError::NoError) {
         qWarning() << "JSON parse error in" << filePath << ":" << error.errorString();
-        return langDef;
+        return QJsonObject();
     }
 
-    QJsonObject root = doc.object();
+    return doc.object();
+}
+
+LanguageDefinition LanguageLoader::parseLanguageDefinition(const QJsonObject &root) const
+{
+    LanguageDefinition langDef;
 
     // Basic info
     langDef.name = root["name"].toString();
@@ -131,39 +94,51 @@ LanguageDefinition LanguageLoader::loadLanguageFromFile(const QString &filePath)
     // Multiline comments
     QJsonObject multilineComments = root["multilineComments"].toObject();
     if (!multilineComments.isEmpty()) {
-        langDef.multilineCommentStart = multilineComments["start"].toString();
-        langDef.multilineCommentEnd = multilineComments["end"].toString();
+        CommentDelimiters primary{multilineComments["start"].toString(), multilineComments["end"].toString()};
+        if (!primary.start.isEmpty() && !primary.end.isEmpty()) {
+            langDef.multilineComments.append(primary);
+        }
+
+        CommentDelimiters alternate{multilineComments["alternateStart"].toString(), multilineComments["alternateEnd"].toString()};
+        if (!alternate.start.isEmpty() && !alternate.end.isEmpty()) {
+            langDef.multilineComments.append(alternate);
+        }
+
+        langDef.nestedComments = multilineComments["nested"].toBool();
     }
 
     return langDef;
 }
 
-QVector<HighlightingRule> LanguageLoader::createHighlightingRules(const LanguageDefinition &langDef, bool useDarkTheme) const
+QVector<QTextCharFormat> LanguageLoader::createCategoryFormats(const LanguageDefinition &langDef, const QStringList &categories,
+                                                              bool useDarkTheme) const
 {
-    QVector<HighlightingRule> rules;
-
-    // Process each pattern category
-    for (auto it = langDef.patterns.begin(); it != langDef.patterns.end(); ++it) {
-        const QString &category = it.key();
-        const QStringList &patterns = it.value();
-        processPatternCategory(category, patterns, langDef, rules, useDarkTheme);
+    QVector<QTextCharFormat> formats;
+    formats.reserve(categories.size());
+    for (const QString &category : categories) {
+        formats.append(createTextFormat(category, langDef, useDarkTheme));
     }
-
-    return rules;
+    return formats;
 }
 
-void LanguageLoader::processPatternCategory(const QString &category, const QStringList &patterns,
-                                          const LanguageDefinition &langDef, QVector<HighlightingRule> &rules, bool useDarkTheme) const
+QTextCharFormat LanguageLoader::createCommentFormat(const LanguageDefinition &langDef, bool useDarkTheme) const
 {
-    QTextCharFormat format = createTextFormat(category, langDef, useDarkTheme);
-
-    for (const QString &pattern : patterns) {
-        HighlightingRule rule;
-        rule.pattern = QRegularExpression(pattern);
-        rule.format = format;
-        rule.category = category;
-        rules.append(rule);
+    QTextCharFormat format;
+
+    // Multiline comments stay visible even if the language has no comment color
+    const QMap<QString, QString> &colorMap = useDarkTheme ? langDef.darkColors : langDef.colors;
+    QString commentColor = colorMap.value("comments", useDarkTheme ? "#6A9955" : "#008000");
+    format.setForeground(QColor(commentColor));
+
+    LanguageStyle commentStyle = langDef.styles.value("comments");
+    if (commentStyle.bold) {
+        format.setFontWeight(QFont::Bold);
+    }
+    if (commentStyle.italic) {
+        format.setFontItalic(true);
     }
+
+    return format;
 }
 
 QTextCharFormat LanguageLoader::createTextFormat(const QString &category, const LanguageDefinition &langDef, bool useDarkTheme) const
@@ -191,18 +166,3 @@ QTextCharFormat LanguageLoader::createTextFormat(const QString &category, const
 
     return format;
 }
-
-QString LanguageLoader::detectLanguageFromExtension(const QString &filename) const
-{
-    QFileInfo fileInfo(filename);
-    QString extension = "." + fileInfo.suffix().toLower();
-
-    for (auto it = languages.begin(); it != languages.end(); ++it) {
-        const LanguageDefinition &langDef = it.value();
-        if (langDef.fileExtensions.contains(extension, Qt::CaseInsensitive)) {
-            return langDef.name;
-        }
-    }
-
-    return QString(); // No language found
-}
\ No newline at end of file
@@ -6,9 +6,11 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QTextCharFormat>
-#include <QRegularExpression>
 #include <QVector>
 #include <QMap>
+#include <QSharedPointer>
+#include "syntaxtokenizer.h"
+#include "commentscanner.h"
 
 struct LanguageStyle {
     QString color;
@@ -27,16 +29,19 @@ struct LanguageDefinition {
     QMap<QString, QStringList> patterns;
 
     // Multiline comment support
-    QString multilineCommentStart;
-    QString multilineCommentEnd;
+    QVector<CommentDelimiters> multilineComments;
+    bool nestedComments = false;
 
     bool isValid() const { return !name.isEmpty(); }
 };
 
-struct HighlightingRule {
-    QRegularExpression pattern;
-    QTextCharFormat format;
-    QString category;
+// Compiled rules for one (language, theme) pair, shared by all highlighters
+struct HighlightingRuleSet {
+    QSharedPointer<const SyntaxTokenizer> tokenizer;
+    QVector<QTextCharFormat> formats;  // Indexed by tokenizer category
+    QVector<bool> opaqueCategories;    // Strings and comments, whose brackets are not code
+    CommentScanner comments;
+    QTextCharFormat commentFormat;
 };
 
 class LanguageLoader
@@ -44,28 +49,26 @@ class LanguageLoader
 public:
     LanguageLoader();
 
-    // Load all language definitions from the languages directory
-    bool loadLanguages(const QString &languagesDir = "languages");
+    // Read and parse a language file (returns an empty object on error)
+    static QJsonObject readLanguageFile(const QString &filePath);
 
-    // Get list of available languages
-    QStringList getAvailableLanguages() const;
+    // Number of language files read from disk since startup
+    static int fileReadCount();
 
-    // Get language definition by name
-    LanguageDefinition getLanguageDefinition(const QString &languageName) const;
+    // Build a language definition from a parsed language file
+    LanguageDefinition parseLanguageDefinition(const QJsonObject &root) const;
 
-    // Create highlighting rules from a language definition
-    QVector<HighlightingRule> createHighlightingRules(const LanguageDefinition &langDef, bool useDarkTheme = false) const;
+    // Create the text format of each pattern category for a theme
+    QVector<QTextCharFormat> createCategoryFormats(const LanguageDefinition &langDef, const QStringList &categories,
+                                                   bool useDarkTheme = false) const;
 
-    // Auto-detect language from file extension
-    QString detectLanguageFromExtension(const QString &filename) const;
+    // Create the text format of multiline comments for a theme
+    QTextCharFormat createCommentFormat(const LanguageDefinition &langDef, bool useDarkTheme = false) const;
 
 private:
-    QMap<QString, LanguageDefinition> languages;
+    static int filesRead;
 
-    LanguageDefinition loadLanguageFromFile(const QString &filePath) const;
     QTextCharFormat createTextFormat(const QString &category, const LanguageDefinition &langDef, bool useDarkTheme = false) const;
-    void processPatternCategory(const QString &category, const QStringList &patterns,
-                              const LanguageDefinition &langDef, QVector<HighlightingRule> &rules, bool useDarkTheme = false) const;
 };
 
-#endif // LANGUAGELOADER_H
\ No newline at end of file
+#endif // LANGUAGELOADER_H
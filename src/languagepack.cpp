@@ -0,0 +1,177 @@
+#include "languagepack.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QIODevice>
+#include <QResource>
+#include <QDebug>
+
+namespace {
+
+const quint32 PackMagic = 0x45444c50;  // "EDLP"
+const quint32 PackVersion = 1;
+const QDataStream::Version StreamVersion = QDataStream::Qt_6_0;
+const char ResourcePath[] = ":/languages.pack";
+
+} // namespace
+
+QByteArray LanguagePack::write(const QVector<Language> &languages)
+{
+    QByteArray pack;
+    QByteArray definitions;
+
+    QDataStream stream(&pack, QIODevice::WriteOnly);
+    stream.setVersion(StreamVersion);
+    stream << PackMagic << PackVersion << quint32(languages.size());
+
+    for (const Language &language : languages) {
+        stream << language.name << language.displayName << language.fileExtensions
+               << language.sourceFile << language.sourceHash
+               << quint32(definitions.size()) << quint32(language.definition.size());
+        definitions += language.definition;
+    }
+
+    return pack + definitions;
+}
+
+bool LanguagePack::read(const QByteArray &data, QVector<Language> &languages)
+{
+    languages.clear();
+    if (data.isEmpty()) {
+        return false;
+    }
+
+    QDataStream stream(data);
+    stream.setVersion(StreamVersion);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != PackMagic || version != PackVersion) {
+        qWarning() << "Ignoring language pack with unsupported format version" << version;
+        return false;
+    }
+
+    QVector<quint32> offsets;
+    QVector<quint32> lengths;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Language language;
+        quint32 offset = 0;
+        quint32 length = 0;
+        stream >> language.name >> language.displayName >> language.fileExtensions
+               >> language.sourceFile >> language.sourceHash >> offset >> length;
+        languages.append(language);
+        offsets.append(offset);
+        lengths.append(length);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Language pack index is truncated";
+        languages.clear();
+        return false;
+    }
+
+    // Definitions follow the index; reference them in place
+    const qint64 definitionsStart = stream.device()->pos();
+    for (int i = 0; i < languages.size(); ++i) {
+        if (definitionsStart + offsets.at(i) + lengths.at(i) > data.size()) {
+            qWarning() << "Language pack entry out of range:" << languages.at(i).name;
+            languages.clear();
+            return false;
+        }
+        languages[i].definition = QByteArray::fromRawData(data.constData() + definitionsStart + offsets.at(i),
+                                                          lengths.at(i));
+    }
+
+    return true;
+}
+
+QByteArray LanguagePack::embeddedData()
+{
+    QResource resource(ResourcePath);
+    if (!resource.isValid()) {
+        return QByteArray();
+    }
+
+    // Stored uncompressed so it can be read straight from the executable
+    if (resource.compressionAlgorithm() == QResource::NoCompression) {
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(resource.data()), resource.size());
+    }
+    return resource.uncompressedData();
+}
+
+QByteArray LanguagePack::encodeDefinition(const LanguageDefinition &langDef)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(StreamVersion);
+
+    stream << langDef.name << langDef.displayName << langDef.fileExtensions
+           << langDef.colors << langDef.darkColors;
+
+    stream << quint32(langDef.styles.size());
+    for (auto it = langDef.styles.begin(); it != langDef.styles.end(); ++it) {
+        stream << it.key() << it.value().color << it.value().bold << it.value().italic;
+    }
+
+    stream << langDef.patterns;
+
+    stream << quint32(langDef.multilineComments.size());
+    for (const CommentDelimiters &delimiters : langDef.multilineComments) {
+        stream << delimiters.start << delimiters.end;
+    }
+    stream << langDef.nestedComments;
+
+    return data;
+}
+
+LanguageDefinition LanguagePack::decodeDefinition(const QByteArray &data)
+{
+    LanguageDefinition langDef;
+    QDataStream stream(data);
+    stream.setVersion(StreamVersion);
+
+    stream >> langDef.name >> langDef.displayName >> langDef.fileExtensions
+           >> langDef.colors >> langDef.darkColors;
+
+    quint32 styleCount = 0;
+    stream >> styleCount;
+    for (quint32 i = 0; i < styleCount && stream.status() == QDataStream::Ok; ++i) {
+        QString category;
+        LanguageStyle style;
+        stream >> category >> style.color >> style.bold >> style.italic;
+        langDef.styles[category] = style;
+    }
+
+    stream >> langDef.patterns;
+
+    quint32 commentCount = 0;
+    stream >> commentCount;
+    for (quint32 i = 0; i < commentCount && stream.status() == QDataStream::Ok; ++i) {
+        CommentDelimiters delimiters;
+        stream >> delimiters.start >> delimiters.end;
+        langDef.multilineComments.append(delimiters);
+    }
+    stream >> langDef.nestedComments;
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Corrupt language definition in pack";
+        return LanguageDefinition();
+    }
+    return langDef;
+}
+
+QByteArray LanguagePack::hashSource(const QByteArray &contents)
+{
+    return QCryptographicHash::hash(contents, QCryptographicHash::Sha1);
+}
+
+QByteArray LanguagePack::hashSourceFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return hashSource(file.readAll());
+}
@@ -0,0 +1,52 @@
+#ifndef LANGUAGEPACK_H
+#define LANGUAGEPACK_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include "languageloader.h"
+
+/**
+ * @brief Binary form of the bundled language definitions
+ *
+ * eddy_langpack compiles the JSON files in languages/ into one pack at build
+ * time and the pack is embedded, uncompressed, as the :/languages.pack
+ * resource. Reading it needs no JSON parsing and no copying: the index is
+ * decoded at startup and each definition is decoded from the executable's
+ * mapped image the first time a highlighter asks for it.
+ *
+ * Layout (QDataStream, Qt 6.0 encoding): magic, version, language count, one
+ * index record per language, then the encoded definitions back to back.
+ */
+class LanguagePack
+{
+public:
+    struct Language {
+        QString name;
+        QString displayName;
+        QStringList fileExtensions;
+        QString sourceFile;     // File name of the JSON the entry was built from
+        QByteArray sourceHash;  // Hash of that file, see hashSource()
+        QByteArray definition;  // Encoded LanguageDefinition
+    };
+
+    // Build a pack from encoded languages
+    static QByteArray write(const QVector<Language> &languages);
+
+    // Read the index of a pack; the definitions point into data, which must
+    // outlive them. Returns false if data is not a pack of this version.
+    static bool read(const QByteArray &data, QVector<Language> &languages);
+
+    // Pack embedded in the executable, empty if it was built without one
+    static QByteArray embeddedData();
+
+    static QByteArray encodeDefinition(const LanguageDefinition &langDef);
+    static LanguageDefinition decodeDefinition(const QByteArray &data);
+
+    // Hash used to tell whether a language file still matches the pack
+    static QByteArray hashSource(const QByteArray &contents);
+    static QByteArray hashSourceFile(const QString &filePath);
+};
+
+#endif // LANGUAGEPACK_H
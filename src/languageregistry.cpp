@@ -0,0 +1,151 @@
+#include "languageregistry.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QHash>
+#include <QDebug>
+#include "languagepack.h"
+
+LanguageRegistry &LanguageRegistry::instance()
+{
+    static LanguageRegistry registry;
+    return registry;
+}
+
+bool LanguageRegistry::ensureLoaded(const QString &languagesDir)
+{
+    QString dirPath = QDir(languagesDir).absolutePath();
+    if (dirPath == loadedDir && !entries.isEmpty()) {
+        return true;
+    }
+
+    entries.clear();
+    loadedDir = dirPath;
+
+    // Bundled languages come precompiled with the executable
+    QVector<LanguagePack::Language> packed;
+    QHash<QString, QByteArray> packedSources;  // JSON file name -> hash of the packed version
+    LanguagePack::read(LanguagePack::embeddedData(), packed);
+    for (const LanguagePack::Language &language : std::as_const(packed)) {
+        Entry entry;
+        entry.name = language.name;
+        entry.displayName = language.displayName;
+        entry.fileExtensions = language.fileExtensions;
+        entry.packed = language.definition;
+        entries[entry.name.toLower()] = entry;
+        packedSources.insert(language.sourceFile, language.sourceHash);
+    }
+
+    // Language files are user additions or edits; they override the pack
+    QDir dir(languagesDir);
+    const QStringList jsonFiles = dir.exists() ? dir.entryList(QStringList() << "*.json", QDir::Files) : QStringList();
+
+    for (const QString &fileName : jsonFiles) {
+        const QString filePath = dir.absoluteFilePath(fileName);
+
+        // An unchanged copy of a bundled file is already in the pack
+        auto packedSource = packedSources.constFind(fileName);
+        if (packedSource != packedSources.constEnd() && LanguagePack::hashSourceFile(filePath) == packedSource.value()) {
+            continue;
+        }
+
+        QJsonObject root = LanguageLoader::readLanguageFile(filePath);
+
+        Entry entry;
+        entry.name = root["name"].toString();
+        if (entry.name.isEmpty()) {
+            qWarning() << "Failed to load language from:" << fileName;
+            continue;
+        }
+
+        entry.displayName = root["displayName"].toString();
+        const QJsonArray extensions = root["fileExtensions"].toArray();
+        for (const auto &ext : extensions) {
+            entry.fileExtensions << ext.toString();
+        }
+        entry.source = root;
+
+        entries[entry.name.toLower()] = entry;
+    }
+
+    if (entries.isEmpty()) {
+        qWarning() << "No language definitions in the language pack or in:" << languagesDir;
+        return false;
+    }
+
+    qDebug() << "Indexed" << entries.size() << "languages," << packed.size() << "from the language pack";
+    return true;
+}
+
+QStringList LanguageRegistry::getAvailableLanguages() const
+{
+    QStringList result;
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        result << it.value().displayName;
+    }
+    result.sort();
+    return result;
+}
+
+QSharedPointer<const LanguageDefinition> LanguageRegistry::getLanguageDefinition(const QString &languageName)
+{
+    auto it = entries.find(languageName.toLower());
+    if (it == entries.end()) {
+        return QSharedPointer<const LanguageDefinition>();
+    }
+
+    Entry &entry = it.value();
+    if (!entry.definition) {
+        LanguageDefinition definition = entry.packed.isEmpty() ? loader.parseLanguageDefinition(entry.source)
+                                                               : LanguagePack::decodeDefinition(entry.packed);
+        entry.definition = QSharedPointer<const LanguageDefinition>::create(definition);
+        entry.source = QJsonObject();
+        entry.packed = QByteArray();
+        qDebug() << "Loaded language:" << entry.displayName;
+    }
+    return entry.definition;
+}
+
+QSharedPointer<const HighlightingRuleSet> LanguageRegistry::getHighlightingRules(const QString &languageName, bool useDarkTheme)
+{
+    QSharedPointer<const LanguageDefinition> langDef = getLanguageDefinition(languageName);
+    if (!langDef) {
+        return QSharedPointer<const HighlightingRuleSet>();
+    }
+
+    Entry &entry = entries[languageName.toLower()];
+    if (!entry.tokenizer) {
+        entry.tokenizer = QSharedPointer<const SyntaxTokenizer>::create(langDef->patterns);
+        qDebug() << "Compiled" << entry.tokenizer->scannerCount() << "pattern scanners and"
+                 << entry.tokenizer->keywordCount() << "keywords for" << langDef->displayName;
+    }
+
+    QSharedPointer<const HighlightingRuleSet> &rules = entry.rules[useDarkTheme ? 1 : 0];
+    if (!rules) {
+        QSharedPointer<HighlightingRuleSet> ruleSet = QSharedPointer<HighlightingRuleSet>::create();
+        ruleSet->tokenizer = entry.tokenizer;
+        ruleSet->formats = loader.createCategoryFormats(*langDef, entry.tokenizer->categories(), useDarkTheme);
+        for (const QString &category : entry.tokenizer->categories()) {
+            ruleSet->opaqueCategories.append(category == "strings" || category == "comments");
+        }
+        ruleSet->comments = CommentScanner(langDef->multilineComments, langDef->nestedComments);
+        ruleSet->commentFormat = loader.createCommentFormat(*langDef, useDarkTheme);
+        rules = ruleSet;
+    }
+    return rules;
+}
+
+QString LanguageRegistry::detectLanguageFromExtension(const QString &filename) const
+{
+    QFileInfo fileInfo(filename);
+    QString extension = "." + fileInfo.suffix().toLower();
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        const Entry &entry = it.value();
+        if (entry.fileExtensions.contains(extension, Qt::CaseInsensitive)) {
+            return entry.name;
+        }
+    }
+
+    return QString(); // No language found
+}
@@ -0,0 +1,64 @@
+#ifndef LANGUAGEREGISTRY_H
+#define LANGUAGEREGISTRY_H
+
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+#include <QMap>
+#include <QSharedPointer>
+#include "languageloader.h"
+
+/**
+ * @brief Process-wide store of language definitions shared by all highlighters
+ *
+ * Languages are indexed once per process: the bundled ones from the
+ * precompiled language pack, plus any file in the languages directory that
+ * is new or differs from the packed copy. Only names and extensions are read
+ * up front; the full LanguageDefinition is decoded (or built from the parsed
+ * JSON) the first time a highlighter asks for it and is then handed out as
+ * an immutable shared pointer. Compiled rule sets are cached the same way
+ * per (language, theme), so opening tabs and switching themes compile each
+ * regular expression only once.
+ */
+class LanguageRegistry
+{
+public:
+    static LanguageRegistry &instance();
+
+    // Index the language pack and the files in languagesDir (no-op if already loaded from it)
+    bool ensureLoaded(const QString &languagesDir = "languages");
+
+    // Get list of available languages (display names)
+    QStringList getAvailableLanguages() const;
+
+    // Get language definition by name (null if unknown)
+    QSharedPointer<const LanguageDefinition> getLanguageDefinition(const QString &languageName);
+
+    // Get compiled highlighting rules for a language and theme (built once, then shared)
+    QSharedPointer<const HighlightingRuleSet> getHighlightingRules(const QString &languageName, bool useDarkTheme);
+
+    // Auto-detect language from file extension
+    QString detectLanguageFromExtension(const QString &filename) const;
+
+private:
+    LanguageRegistry() = default;
+    LanguageRegistry(const LanguageRegistry &) = delete;
+    LanguageRegistry &operator=(const LanguageRegistry &) = delete;
+
+    struct Entry {
+        QString name;
+        QString displayName;
+        QStringList fileExtensions;
+        QJsonObject source;  // Parsed file, released once the definition is built
+        QByteArray packed;   // Encoded definition from the language pack, likewise
+        QSharedPointer<const LanguageDefinition> definition;
+        QSharedPointer<const SyntaxTokenizer> tokenizer;      // Theme independent
+        QSharedPointer<const HighlightingRuleSet> rules[2];  // Light, dark
+    };
+
+    QMap<QString, Entry> entries;  // Keyed by lower-case language name
+    QString loadedDir;
+    LanguageLoader loader;
+};
+
+#endif // LANGUAGEREGISTRY_H
@@ -0,0 +1,1028 @@
+#include "largefileview.h"
+#include <QByteArrayMatcher>
+#include <QClipboard>
+#include <QGuiApplication>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QSaveFile>
+#include <QScrollBar>
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+namespace {
+
+// Bytes indexed between progress reports
+const qint64 IndexChunkBytes = 8 * 1024 * 1024;
+
+// Bytes at the start of the file its line break style is told from
+const qint64 LineBreakSampleBytes = 64 * 1024;
+
+// Longest part of a line that is painted and edited, and that is searched
+const qint64 MaxPaintedLineBytes = 16 * 1024;
+const qint64 MaxSearchedLineBytes = 4 * 1024 * 1024;
+
+// Lines searched between checks for cancellation
+const int CancelCheckLines = 4096;
+
+const int TabWidth = 4;
+const int GutterMargin = 5;
+const int TextMargin = 4;
+const int CursorWidth = 2;
+const QColor GutterTextColor(105, 109, 121);
+const QColor MatchColor(255, 152, 0, 110);
+
+struct Match {
+    qint64 lineStart = -1;
+    int column = -1;
+    int length = 0;
+};
+
+// text with its tabs expanded to the next multiple of TabWidth columns
+QString expandTabs(const QString &text)
+{
+    if (!text.contains('\t')) {
+        return text;
+    }
+    QString shown;
+    shown.reserve(text.size() + TabWidth);
+    for (QChar c : text) {
+        if (c == '\t') {
+            shown.append(QString(TabWidth - shown.size() % TabWidth, QLatin1Char(' ')));
+        } else {
+            shown.append(c);
+        }
+    }
+    return shown;
+}
+
+// Column of expandTabs(text) that column of text ends up in
+int displayColumn(const QString &text, int column)
+{
+    int shown = 0;
+    for (int i = 0; i < column && i < text.size(); ++i) {
+        shown = text.at(i) == '\t' ? shown + TabWidth - shown % TabWidth : shown + 1;
+    }
+    return shown;
+}
+
+// Columns next to column that do not split a surrogate pair
+int previousColumn(const QString &text, int column)
+{
+    return column >= 2 && text.at(column - 1).isLowSurrogate() ? column - 2 : column - 1;
+}
+
+int nextColumn(const QString &text, int column)
+{
+    return column + 1 < text.size() && text.at(column).isHighSurrogate() ? column + 2 : column + 1;
+}
+
+// Code point of the UTF-8 sequence at p, which has available bytes, and
+// its length in *length; -1 if it is not a whole, well-formed sequence
+int decodeSequence(const unsigned char *p, qint64 available, int *length)
+{
+    const unsigned char lead = p[0];
+    int count;
+    char32_t c;
+    char32_t lowest;
+    if (lead <= 0x7F) {
+        *length = 1;
+        return lead;
+    } else if ((lead & 0xE0) == 0xC0) {
+        count = 1;
+        c = lead & 0x1F;
+        lowest = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        count = 2;
+        c = lead & 0x0F;
+        lowest = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        count = 3;
+        c = lead & 0x07;
+        lowest = 0x10000;
+    } else {
+        return -1;
+    }
+    if (count >= available) {
+        return -1;
+    }
+    for (int i = 1; i <= count; ++i) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return -1;
+        }
+        c = (c << 6) | (p[i] & 0x3F);
+    }
+    if (c < lowest || c > QChar::LastValidCodePoint || QChar::isSurrogate(c)) {
+        return -1; // Overlong, beyond Unicode or a surrogate
+    }
+    *length = count + 1;
+    return int(c);
+}
+
+// The bytes of a line, and in columnBytes (may be null) the offset in them
+// of every column and of the end. Each invalid UTF-8 byte is a U+FFFD
+// column of its own, so edits at any column touch exactly its bytes.
+QString decodeLine(const QByteArray &bytes, EncodingManager::Encoding encoding, QVector<int> *columnBytes)
+{
+    if (encoding != EncodingManager::Encoding::UTF8) {
+        // ASCII and the Latin code pages: a byte per column
+        if (columnBytes) {
+            columnBytes->resize(bytes.size() + 1);
+            for (int i = 0; i <= bytes.size(); ++i) {
+                (*columnBytes)[i] = i;
+            }
+        }
+        return EncodingManager::decode(bytes, encoding);
+    }
+
+    const auto *p = reinterpret_cast<const unsigned char *>(bytes.constData());
+    const int total = int(bytes.size());
+    QString text;
+    text.reserve(total);
+    if (columnBytes) {
+        columnBytes->clear();
+        columnBytes->reserve(total + 1);
+    }
+    for (int i = 0; i < total;) {
+        int length = 1;
+        const int c = decodeSequence(p + i, total - i, &length);
+        if (c < 0) {
+            text.append(QChar(QChar::ReplacementCharacter));
+        } else if (QChar::requiresSurrogates(char32_t(c))) {
+            text.append(QChar(QChar::highSurrogate(char32_t(c))));
+            text.append(QChar(QChar::lowSurrogate(char32_t(c))));
+            if (columnBytes) {
+                columnBytes->append(i); // The low surrogate, never a cursor column
+            }
+        } else {
+            text.append(QChar(char16_t(c)));
+        }
+        if (columnBytes) {
+            columnBytes->append(i);
+        }
+        i += length;
+    }
+    if (columnBytes) {
+        columnBytes->append(total);
+    }
+    return text;
+}
+
+// Length of UTF-8 bytes cut off at an arbitrary point, less a sequence left
+// incomplete at the end
+qsizetype wholeCharacters(const QByteArray &bytes)
+{
+    const qsizetype size = bytes.size();
+    for (qsizetype start = size - 1; start >= qMax<qsizetype>(0, size - 4); --start) {
+        const unsigned char c = static_cast<unsigned char>(bytes.at(start));
+        if ((c & 0xC0) == 0x80) {
+            continue; // Continuation byte
+        }
+        const int length = (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 1;
+        return size - start < length ? start : size;
+    }
+    return size;
+}
+
+// Last match in line that starts before column before, or -1
+int lastIndexIn(const SearchIndex &index, const QString &line, int before, int *length)
+{
+    int found = -1;
+    int matchLength = 0;
+    for (int at = index.indexIn(line, 0, &matchLength); at >= 0 && at < before;
+         at = index.indexIn(line, at + 1, &matchLength)) {
+        found = at;
+        *length = matchLength;
+    }
+    return found;
+}
+
+/**
+ * One search over a snapshot of the text, run on the search worker. Lines
+ * are decoded one at a time; for plain case-sensitive text a line is first
+ * checked for the encoded bytes, so lines without them are never decoded.
+ * Only the bytes of the snapshot are read, never the line index, which
+ * keeps growing on the GUI thread.
+ */
+class FileSearch
+{
+public:
+    FileSearch(const PieceTable &table, EncodingManager::Encoding encoding, qint64 textStart,
+               const SearchIndex &index, const std::function<bool()> &cancelled)
+        : table(table), encoding(encoding), textStart(textStart), index(index), cancelled(cancelled)
+    {
+        const SearchIndex::Query &query = index.query();
+        prefilter = !query.useRegex && query.caseSensitive;
+        if (prefilter) {
+            // Empty if the text cannot be encoded, in which case nothing matches
+            matcher.setPattern(EncodingManager::encode(query.text, encoding));
+        }
+    }
+
+    // First match after column from of the line starting at lineStart,
+    // wrapping around at the end of the text
+    Match forward(qint64 lineStart, int from) const
+    {
+        if (prefilter && matcher.pattern().isEmpty()) {
+            return Match();
+        }
+        const Match match = forwardIn(lineStart, table.size() + 1, from);
+        if (match.lineStart >= 0 || cancelled()) {
+            return match;
+        }
+        return forwardIn(0, lineStart + 1, 0);
+    }
+
+    // Last match before column before of the line starting at lineStart,
+    // wrapping around at the start of the text
+    Match backward(qint64 lineStart, int before) const
+    {
+        if (prefilter && matcher.pattern().isEmpty()) {
+            return Match();
+        }
+        const Match match = backwardIn(lineStart, 0, before);
+        if (match.lineStart >= 0 || cancelled()) {
+            return match;
+        }
+        return backwardIn(table.startOfLine(table.size()), lineStart, INT_MAX);
+    }
+
+private:
+    const PieceTable &table;
+    EncodingManager::Encoding encoding;
+    qint64 textStart;
+    const SearchIndex &index;
+    const std::function<bool()> &cancelled;
+    bool prefilter;
+    QByteArrayMatcher matcher;
+
+    // Columns as the view counts them, from after the byte order mark
+    QString decode(qint64 lineStart, const QByteArray &bytes) const
+    {
+        return decodeLine(lineStart == 0 ? bytes.mid(textStart) : bytes, encoding, nullptr);
+    }
+
+    // Lines starting in [from, to); the first is searched from column
+    Match forwardIn(qint64 from, qint64 to, int column) const
+    {
+        Match match;
+        int count = 0;
+        table.forEachLine(from, to, MaxSearchedLineBytes, [&](qint64 lineStart, const QByteArray &bytes) {
+            if (++count % CancelCheckLines == 0 && cancelled()) {
+                return true;
+            }
+            const int startColumn = lineStart == from ? column : 0;
+            if (prefilter && startColumn == 0 && matcher.indexIn(bytes) < 0) {
+                return false;
+            }
+            int length = 0;
+            const int found = index.indexIn(decode(lineStart, bytes), startColumn, &length);
+            if (found >= 0) {
+                match = {lineStart, found, length};
+                return true;
+            }
+            return false;
+        });
+        return match;
+    }
+
+    // Lines starting in [to, from], last to first; the first is searched
+    // before column before
+    Match backwardIn(qint64 from, qint64 to, int before) const
+    {
+        Match match;
+        int count = 0;
+        table.forEachLineBackward(from, to, MaxSearchedLineBytes, [&](qint64 lineStart, const QByteArray &bytes) {
+            if (++count % CancelCheckLines == 0 && cancelled()) {
+                return true;
+            }
+            if (prefilter && matcher.indexIn(bytes) < 0) {
+                return false;
+            }
+            int length = 0;
+            const int limit = lineStart == from ? before : INT_MAX;
+            const int found = lastIndexIn(index, decode(lineStart, bytes), limit, &length);
+            if (found >= 0) {
+                match = {lineStart, found, length};
+                return true;
+            }
+            return false;
+        });
+        return match;
+    }
+};
+
+} // namespace
+
+LargeFileView::LargeFileView(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , data(nullptr)
+    , size(0)
+    , textStart(0)
+    , lineBreak("\n")
+    , fileEncoding(EncodingManager::Encoding::UTF8)
+    , validatingEncoding(false)
+    , indexWorker(nullptr)
+    , indexGeneration(0)
+    , cursorLine(0)
+    , cursorColumn(0)
+    , matchStart(-1)
+    , matchLine(-1)
+    , matchColumn(0)
+    , matchLength(0)
+    , searchForward(true)
+    , searchPending(false)
+    , searchWorker(nullptr)
+    , searchWorkerGeneration(0)
+    , searchWorkerStartedGeneration(0)
+    , searchGeneration(0)
+    , widestLine(0)
+{
+    setFocusPolicy(Qt::StrongFocus);
+    viewport()->setAttribute(Qt::WA_OpaquePaintEvent);
+    viewport()->setCursor(Qt::IBeamCursor);
+}
+
+LargeFileView::~LargeFileView()
+{
+    // Both workers read the mapping, which goes with the file
+    indexGeneration.storeRelaxed(-1);
+    if (indexWorker) {
+        indexWorker->wait();
+        delete indexWorker;
+    }
+    searchWorkerGeneration.storeRelaxed(-1);
+    if (searchWorker) {
+        searchWorker->wait();
+        delete searchWorker;
+    }
+}
+
+bool LargeFileView::openFile(const QString &fileName)
+{
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 fileSize = file.size();
+    uchar *mapped = fileSize > 0 ? file.map(0, fileSize) : nullptr;
+    if (!mapped) {
+        file.close();
+        return false;
+    }
+    const char *bytes = reinterpret_cast<const char *>(mapped);
+
+    // The encoding is told from the start and the end of the file; unless
+    // that is certain, the index worker checks every byte. ASCII is read as
+    // UTF-8, which decodes it the same and any UTF-8 further on correctly.
+    const EncodingManager::Detection detection = EncodingManager::detect(QByteArray::fromRawData(bytes, fileSize));
+    EncodingManager::Encoding encoding = detection.encoding;
+    if (encoding == EncodingManager::Encoding::ASCII && !detection.isCertain()) {
+        encoding = EncodingManager::Encoding::UTF8;
+    }
+    validatingEncoding = !detection.isCertain();
+    switch (encoding) {
+    case EncodingManager::Encoding::UTF16LE:
+    case EncodingManager::Encoding::UTF16BE:
+    case EncodingManager::Encoding::UTF32LE:
+    case EncodingManager::Encoding::UTF32BE:
+        file.unmap(mapped);
+        file.close();
+        return false;
+    default:
+        break;
+    }
+
+    data = bytes;
+    size = fileSize;
+    fileEncoding = encoding;
+    const QByteArray sample = QByteArray::fromRawData(bytes, qMin(fileSize, LineBreakSampleBytes));
+    textStart = sample.startsWith(EncodingManager::getBOM(EncodingManager::Encoding::UTF8)) ? 3 : 0;
+    const qsizetype firstNewline = sample.indexOf('\n');
+    lineBreak = firstNewline > 0 && sample.at(firstNewline - 1) == '\r' ? "\r\n" : "\n";
+    index = LineIndex(data, size);
+    table = PieceTable(&index);
+
+    updateScrollBars();
+    startIndexWorker();
+    return true;
+}
+
+bool LargeFileView::save(const QString &fileName, QString *error)
+{
+    // QSaveFile renames a new file over the old one; the old file stays
+    // mapped until the view goes, so the pieces still read the right bytes
+    QSaveFile out(fileName);
+    if (!out.open(QIODevice::WriteOnly) || !table.write(&out) || !out.commit()) {
+        if (error) {
+            *error = out.errorString();
+        }
+        return false;
+    }
+    table.setClean();
+    emit modificationChanged(false);
+    return true;
+}
+
+void LargeFileView::startIndexWorker()
+{
+    const char *bytes = data;
+    const qint64 total = size;
+    const int forGeneration = indexGeneration.loadRelaxed();
+    const bool validate = validatingEncoding;
+
+    indexWorker = QThread::create([this, bytes, total, forGeneration, validate]() {
+        // The bytes being indexed are checked for UTF-8 on the way; the
+        // verdict on the last chunk arrives with it, before editing starts
+        EncodingManager::StreamValidator validator;
+        bool validUtf8 = true;
+        qint64 lineCount = 1;
+        for (qint64 begin = 0; begin < total; begin += IndexChunkBytes) {
+            if (indexGeneration.loadRelaxed() != forGeneration) {
+                return;
+            }
+            const qint64 end = qMin(total, begin + IndexChunkBytes);
+            QVector<qint64> checkpoints;
+            lineCount = LineIndex::scan(bytes, begin, end, lineCount, &checkpoints);
+            if (validate && validUtf8) {
+                validator.append(bytes + begin, end - begin);
+                if (end == total) {
+                    validator.finish();
+                }
+                validUtf8 = validator.encoding() != EncodingManager::Encoding::ISO_8859_1;
+            }
+            QMetaObject::invokeMethod(this, [this, checkpoints, lineCount, end, validUtf8]() {
+                applyIndexChunk(checkpoints, lineCount, end, validUtf8);
+            }, Qt::QueuedConnection);
+        }
+    });
+    connect(indexWorker, &QThread::finished, this, &LargeFileView::onIndexWorkerFinished);
+    indexWorker->start(QThread::LowPriority);
+}
+
+void LargeFileView::onIndexWorkerFinished()
+{
+    if (indexWorker) {
+        indexWorker->deleteLater();
+        indexWorker = nullptr;
+    }
+}
+
+void LargeFileView::applyIndexChunk(const QVector<qint64> &checkpoints, qint64 lineCount, qint64 end, bool validUtf8)
+{
+    // Bytes that are not UTF-8 turn the file to Latin-1, as detection on the
+    // whole file would have; nothing is edited before the last chunk
+    if (!validUtf8 && fileEncoding == EncodingManager::Encoding::UTF8) {
+        fileEncoding = EncodingManager::Encoding::ISO_8859_1;
+        matchStart = -1;
+        matchLine = -1;
+        cursorColumn = 0;
+        viewport()->update();
+        emit encodingChanged(fileEncoding);
+    }
+
+    const qint64 shownBefore = index.lineCount();
+    index.extend(checkpoints, lineCount, end);
+    updateScrollBars();
+
+    // Repaint only if the new lines reach the screen
+    if (verticalScrollBar()->value() + visibleLineCount() >= shownBefore) {
+        viewport()->update();
+    }
+
+    // A match found ahead of the index is revealed once its line is known
+    if (matchStart >= 0 && matchLine < 0 && matchStart < index.indexedBytes()) {
+        matchLine = table.lineAt(matchStart);
+        revealMatch();
+    }
+
+    emit indexProgress(int(end * 100 / size));
+    if (index.isComplete()) {
+        emit indexFinished(index.lineCount());
+    }
+}
+
+void LargeFileView::find(const SearchIndex::Query &query, bool forward)
+{
+    if (!data || query.isEmpty()) {
+        return;
+    }
+    if (query != searchIndex.query()) {
+        searchIndex = SearchIndex(query);
+    }
+    searchForward = forward;
+
+    ++searchGeneration;
+    searchPending = true;
+    searchWorkerGeneration.storeRelaxed(searchGeneration);
+
+    // A running search is cancelled; onSearchWorkerFinished starts the next one
+    if (!searchWorker) {
+        startSearchWorker();
+    }
+}
+
+void LargeFileView::startSearchWorker()
+{
+    // From the current match, or from the cursor
+    qint64 lineStart = matchStart;
+    int column = searchForward ? matchColumn + qMax(1, matchLength) : matchColumn;
+    if (lineStart < 0) {
+        lineStart = table.lineStart(cursorLine);
+        column = cursorColumn;
+    }
+
+    // The copy shares the pieces and buffers until the next edit
+    const PieceTable snapshot = table;
+    const EncodingManager::Encoding encoding = fileEncoding;
+    const qint64 skip = textStart;
+    const SearchIndex query = searchIndex;
+    const bool forward = searchForward;
+    const int forGeneration = searchGeneration;
+    searchWorkerStartedGeneration = forGeneration;
+
+    searchWorker = QThread::create([this, snapshot, encoding, skip, query, forward, lineStart, column, forGeneration]() {
+        const std::function<bool()> cancelled = [this, forGeneration]() {
+            return searchWorkerGeneration.loadRelaxed() != forGeneration;
+        };
+        const FileSearch search(snapshot, encoding, skip, query, cancelled);
+        const Match match = forward ? search.forward(lineStart, column) : search.backward(lineStart, column);
+        if (cancelled()) {
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, match, forGeneration]() {
+            applySearchResult(match.lineStart, match.column, match.length, forGeneration);
+        }, Qt::QueuedConnection);
+    });
+    connect(searchWorker, &QThread::finished, this, &LargeFileView::onSearchWorkerFinished);
+    searchWorker->start();
+}
+
+void LargeFileView::onSearchWorkerFinished()
+{
+    if (searchWorker) {
+        searchWorker->deleteLater();
+        searchWorker = nullptr;
+    }
+
+    if (searchPending && searchWorkerStartedGeneration != searchGeneration) {
+        startSearchWorker();
+    }
+}
+
+void LargeFileView::applySearchResult(qint64 lineStart, int column, int length, int forGeneration)
+{
+    if (forGeneration != searchGeneration) {
+        return;
+    }
+    searchPending = false;
+
+    if (lineStart < 0) {
+        emit searchFinished(false);
+        return;
+    }
+
+    matchStart = lineStart;
+    matchColumn = column;
+    matchLength = length;
+    matchLine = table.isEditable() || lineStart < index.indexedBytes() ? table.lineAt(lineStart) : -1;
+    revealMatch();
+    emit searchFinished(true);
+}
+
+void LargeFileView::revealMatch()
+{
+    if (matchLine < 0) {
+        return;
+    }
+
+    // A third of the way down, as far as the range allows
+    const qint64 first = verticalScrollBar()->value();
+    if (matchLine < first || matchLine >= first + visibleLineCount() - 1) {
+        goToLine(matchLine - visibleLineCount() / 3);
+    }
+
+    cursorLine = matchLine;
+    cursorColumn = matchColumn + matchLength;
+    ensureColumnsVisible(lineText(matchLine), matchColumn, matchColumn + matchLength);
+    viewport()->update();
+}
+
+void LargeFileView::goToLine(qint64 line)
+{
+    verticalScrollBar()->setValue(int(qBound<qint64>(0, line, INT_MAX)));
+}
+
+qint64 LargeFileView::lineByteStart(qint64 line) const
+{
+    // Columns of the first line count from after the byte order mark
+    return line == 0 ? qMin(textStart, table.size()) : table.lineStart(line);
+}
+
+qint64 LargeFileView::cursorOffset() const
+{
+    QVector<int> columnBytes;
+    lineText(cursorLine, &columnBytes);
+    return lineByteStart(cursorLine) + columnBytes.at(qMin(cursorColumn, int(columnBytes.size()) - 1));
+}
+
+void LargeFileView::setCursorOffset(qint64 offset)
+{
+    const qint64 line = table.lineAt(offset);
+    QVector<int> columnBytes;
+    lineText(line, &columnBytes);
+    const qint64 inLine = offset - lineByteStart(line);
+    const auto column = std::lower_bound(columnBytes.cbegin(), columnBytes.cend(), inLine);
+    moveCursor(line, int(column - columnBytes.cbegin()));
+}
+
+void LargeFileView::moveCursor(qint64 line, int column)
+{
+    cursorLine = qBound<qint64>(0, line, table.lineCount() - 1);
+    const QString text = lineText(cursorLine);
+    cursorColumn = qBound(0, column, int(text.size()));
+
+    // Into view, as little as possible
+    const qint64 first = verticalScrollBar()->value();
+    const int pageLines = qMax(1, viewport()->height() / fontMetrics().height());
+    if (cursorLine < first) {
+        goToLine(cursorLine);
+    } else if (cursorLine >= first + pageLines) {
+        goToLine(cursorLine - pageLines + 1);
+    }
+    ensureColumnsVisible(text, cursorColumn, cursorColumn);
+    viewport()->update();
+}
+
+void LargeFileView::insertText(const QString &text)
+{
+    if (!table.isEditable() || text.isEmpty()) {
+        return;
+    }
+
+    // Line breaks as the file has them
+    QString normalized = text;
+    normalized.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    normalized.replace(QLatin1Char('\n'), QString::fromLatin1(lineBreak));
+
+    const qint64 offset = cursorOffset();
+    const QByteArray bytes = EncodingManager::encode(normalized, fileEncoding, true);
+    table.replace(offset, 0, bytes);
+    setCursorOffset(offset + bytes.size());
+    afterEdit();
+}
+
+void LargeFileView::deleteBackward()
+{
+    if (!table.isEditable()) {
+        return;
+    }
+
+    if (cursorColumn > 0) {
+        QVector<int> columnBytes;
+        const QString text = lineText(cursorLine, &columnBytes);
+        const int from = previousColumn(text, cursorColumn);
+        table.replace(lineByteStart(cursorLine) + columnBytes.at(from), columnBytes.at(cursorColumn) - columnBytes.at(from),
+                      QByteArray());
+        moveCursor(cursorLine, from);
+    } else if (cursorLine > 0) {
+        // Join with the line above
+        const qint64 start = table.lineStart(cursorLine);
+        const int breakLength = start >= 2 && table.read(start - 2, 1) == "\r" ? 2 : 1;
+        const int column = int(lineText(cursorLine - 1).size());
+        table.replace(start - breakLength, breakLength, QByteArray());
+        moveCursor(cursorLine - 1, column);
+    } else {
+        return;
+    }
+    afterEdit();
+}
+
+void LargeFileView::deleteForward()
+{
+    if (!table.isEditable()) {
+        return;
+    }
+
+    QVector<int> columnBytes;
+    const QString text = lineText(cursorLine, &columnBytes);
+    if (cursorColumn < text.size()) {
+        const int to = nextColumn(text, cursorColumn);
+        table.replace(lineByteStart(cursorLine) + columnBytes.at(cursorColumn), columnBytes.at(to) - columnBytes.at(cursorColumn),
+                      QByteArray());
+    } else if (cursorLine + 1 < table.lineCount()) {
+        // Join with the line below, unless this line is longer than is shown
+        const qint64 next = table.lineStart(cursorLine + 1);
+        const int breakLength = next >= 2 && table.read(next - 2, 1) == "\r" ? 2 : 1;
+        if (cursorOffset() != next - breakLength) {
+            return;
+        }
+        table.replace(next - breakLength, breakLength, QByteArray());
+    } else {
+        return;
+    }
+    moveCursor(cursorLine, cursorColumn);
+    afterEdit();
+}
+
+void LargeFileView::undoOrRedo(bool undo)
+{
+    if (undo ? !table.canUndo() : !table.canRedo()) {
+        return;
+    }
+    setCursorOffset(undo ? table.undo() : table.redo());
+    afterEdit();
+}
+
+void LargeFileView::afterEdit()
+{
+    // Matches are kept by offset, which the edit may have moved
+    matchStart = -1;
+    matchLine = -1;
+    updateScrollBars();
+    viewport()->update();
+    emit modificationChanged(table.isModified());
+}
+
+QString LargeFileView::lineText(qint64 line, QVector<int> *columnBytes) const
+{
+    const qint64 start = table.lineStart(line);
+    QByteArray bytes = table.lineBytes(start, MaxPaintedLineBytes);
+
+    // A cut that splits a character ends the line before it, so no column
+    // stands for part of a character
+    if (bytes.size() == MaxPaintedLineBytes && fileEncoding == EncodingManager::Encoding::UTF8) {
+        bytes.truncate(wholeCharacters(bytes));
+    }
+    return decodeLine(bytes.mid(lineByteStart(line) - start), fileEncoding, columnBytes);
+}
+
+int LargeFileView::columnAt(const QString &text, int x) const
+{
+    // The last column whose left edge is nearer than the next one's
+    const QFontMetrics metrics(font());
+    const QString shown = expandTabs(text);
+    const int halfCharacter = metrics.horizontalAdvance(QLatin1Char('9')) / 2;
+    int low = 0;
+    int high = int(text.size());
+    while (low < high) {
+        const int middle = (low + high + 1) / 2;
+        if (metrics.horizontalAdvance(shown.left(displayColumn(text, middle))) <= x + halfCharacter) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+int LargeFileView::gutterWidth() const
+{
+    const int digits = int(QString::number(table.lineCount()).size());
+    return fontMetrics().horizontalAdvance(QLatin1Char('9')) * digits + 2 * GutterMargin;
+}
+
+int LargeFileView::visibleLineCount() const
+{
+    return viewport()->height() / fontMetrics().height() + 1;
+}
+
+void LargeFileView::ensureColumnsVisible(const QString &text, int from, int to)
+{
+    const QString shown = expandTabs(text);
+    const QFontMetrics metrics(font());
+    const int left = metrics.horizontalAdvance(shown.left(displayColumn(text, from)));
+    const int right = metrics.horizontalAdvance(shown.left(displayColumn(text, to))) + CursorWidth;
+    widestLine = qMax(widestLine, metrics.horizontalAdvance(shown) + CursorWidth);
+    updateScrollBars();
+
+    const int textWidth = viewport()->width() - gutterWidth() - TextMargin;
+    QScrollBar *horizontal = horizontalScrollBar();
+    if (left < horizontal->value() || right > horizontal->value() + textWidth) {
+        horizontal->setValue(left - textWidth / 4);
+    }
+}
+
+void LargeFileView::updateScrollBars()
+{
+    // Lines past INT_MAX cannot be scrolled to
+    const int pageLines = qMax(1, viewport()->height() / fontMetrics().height());
+    const qint64 lastTopLine = qMax<qint64>(0, table.lineCount() - pageLines);
+    QScrollBar *vertical = verticalScrollBar();
+    vertical->setRange(0, int(qMin<qint64>(lastTopLine, INT_MAX)));
+    vertical->setPageStep(pageLines);
+    vertical->setSingleStep(1);
+
+    const int textWidth = viewport()->width() - gutterWidth() - TextMargin;
+    QScrollBar *horizontal = horizontalScrollBar();
+    horizontal->setRange(0, qMax(0, widestLine - textWidth));
+    horizontal->setPageStep(textWidth);
+    horizontal->setSingleStep(fontMetrics().horizontalAdvance(QLatin1Char('9')));
+}
+
+bool LargeFileView::event(QEvent *event)
+{
+    // Editing keys go to the view rather than to the window's shortcuts
+    if (event->type() == QEvent::ShortcutOverride) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        if (keyEvent->matches(QKeySequence::Undo) || keyEvent->matches(QKeySequence::Redo) ||
+            keyEvent->matches(QKeySequence::Paste) || keyEvent->matches(QKeySequence::MoveToStartOfDocument) ||
+            keyEvent->matches(QKeySequence::MoveToEndOfDocument)) {
+            event->accept();
+            return true;
+        }
+    }
+    return QAbstractScrollArea::event(event);
+}
+
+void LargeFileView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().base());
+    if (!data) {
+        return;
+    }
+
+    const QFontMetrics metrics(font());
+    const int lineHeight = metrics.height();
+    const int height = viewport()->height();
+    const int gutter = gutterWidth();
+    const int textLeft = gutter + TextMargin - horizontalScrollBar()->value();
+    const qint64 first = verticalScrollBar()->value();
+    const qint64 end = qMin(table.lineCount(), first + visibleLineCount());
+
+    // Text, clipped to the right of the gutter
+    painter.setClipRect(gutter, 0, viewport()->width() - gutter, height);
+    painter.setPen(palette().text().color());
+    const int widestBefore = widestLine;
+    int y = 0;
+    for (qint64 line = first; line < end; ++line, y += lineHeight) {
+        const QString text = lineText(line);
+        const QString shown = expandTabs(text);
+        widestLine = qMax(widestLine, metrics.horizontalAdvance(shown));
+
+        if (line == matchLine && matchLength > 0) {
+            const int left = metrics.horizontalAdvance(shown.left(displayColumn(text, matchColumn)));
+            const int right = metrics.horizontalAdvance(shown.left(displayColumn(text, matchColumn + matchLength)));
+            painter.fillRect(QRect(textLeft + left, y, right - left, lineHeight), MatchColor);
+        }
+        painter.drawText(textLeft, y + metrics.ascent(), shown);
+
+        if (line == cursorLine && hasFocus()) {
+            const int x = metrics.horizontalAdvance(shown.left(displayColumn(text, cursorColumn)));
+            painter.fillRect(QRect(textLeft + x, y, CursorWidth, lineHeight), palette().text());
+        }
+    }
+    painter.setClipping(false);
+
+    // Line numbers
+    painter.fillRect(0, 0, gutter, height, palette().window());
+    painter.setPen(GutterTextColor);
+    y = 0;
+    for (qint64 line = first; line < end; ++line, y += lineHeight) {
+        painter.drawText(QRect(0, y, gutter - GutterMargin, lineHeight), Qt::AlignRight | Qt::AlignVCenter,
+                         QString::number(line + 1));
+    }
+
+    if (widestLine != widestBefore) {
+        updateScrollBars();
+    }
+}
+
+void LargeFileView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void LargeFileView::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::Undo)) {
+        undoOrRedo(true);
+        return;
+    }
+    if (event->matches(QKeySequence::Redo)) {
+        undoOrRedo(false);
+        return;
+    }
+    if (event->matches(QKeySequence::Paste)) {
+        insertText(QGuiApplication::clipboard()->text());
+        return;
+    }
+    if (event->matches(QKeySequence::MoveToStartOfDocument)) {
+        moveCursor(0, 0);
+        return;
+    }
+    if (event->matches(QKeySequence::MoveToEndOfDocument)) {
+        moveCursor(table.lineCount() - 1, INT_MAX);
+        return;
+    }
+
+    const int pageLines = qMax(1, viewport()->height() / fontMetrics().height());
+    switch (event->key()) {
+    case Qt::Key_Up:
+        moveCursor(cursorLine - 1, cursorColumn);
+        return;
+    case Qt::Key_Down:
+        moveCursor(cursorLine + 1, cursorColumn);
+        return;
+    case Qt::Key_PageUp:
+        moveCursor(cursorLine - pageLines, cursorColumn);
+        return;
+    case Qt::Key_PageDown:
+        moveCursor(cursorLine + pageLines, cursorColumn);
+        return;
+    case Qt::Key_Left:
+        if (cursorColumn > 0) {
+            moveCursor(cursorLine, previousColumn(lineText(cursorLine), cursorColumn));
+        } else if (cursorLine > 0) {
+            moveCursor(cursorLine - 1, INT_MAX);
+        }
+        return;
+    case Qt::Key_Right: {
+        const QString text = lineText(cursorLine);
+        if (cursorColumn < text.size()) {
+            moveCursor(cursorLine, nextColumn(text, cursorColumn));
+        } else if (cursorLine + 1 < table.lineCount()) {
+            moveCursor(cursorLine + 1, 0);
+        }
+        return;
+    }
+    case Qt::Key_Home:
+        moveCursor(cursorLine, 0);
+        return;
+    case Qt::Key_End:
+        moveCursor(cursorLine, INT_MAX);
+        return;
+    case Qt::Key_Backspace:
+        deleteBackward();
+        return;
+    case Qt::Key_Delete:
+        deleteForward();
+        return;
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        insertText(QStringLiteral("\n"));
+        return;
+    case Qt::Key_Tab:
+        insertText(QStringLiteral("\t"));
+        return;
+    default:
+        break;
+    }
+
+    const QString text = event->text();
+    if (!text.isEmpty() && text.at(0).isPrint()) {
+        insertText(text);
+        return;
+    }
+    QAbstractScrollArea::keyPressEvent(event);
+}
+
+void LargeFileView::mousePressEvent(QMouseEvent *event)
+{
+    if (!data || event->button() != Qt::LeftButton) {
+        QAbstractScrollArea::mousePressEvent(event);
+        return;
+    }
+
+    const QPoint position = event->position().toPoint();
+    const qint64 line = verticalScrollBar()->value() + position.y() / fontMetrics().height();
+    const int x = position.x() - gutterWidth() - TextMargin + horizontalScrollBar()->value();
+    const qint64 clampedLine = qMin(line, table.lineCount() - 1);
+    moveCursor(clampedLine, columnAt(lineText(clampedLine), x));
+}
+
+void LargeFileView::focusInEvent(QFocusEvent *event)
+{
+    QAbstractScrollArea::focusInEvent(event);
+    viewport()->update();
+}
+
+void LargeFileView::focusOutEvent(QFocusEvent *event)
+{
+    QAbstractScrollArea::focusOutEvent(event);
+    viewport()->update();
+}
+
+bool LargeFileView::focusNextPrevChild(bool)
+{
+    return false;  // Tab is typed, not used to move focus
+}
+
+void LargeFileView::changeEvent(QEvent *event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (event->type() == QEvent::FontChange) {
+        widestLine = 0;
+        updateScrollBars();
+        viewport()->update();
+    }
+}
+
+void LargeFileView::scrollContentsBy(int, int)
+{
+    // Scroll positions are lines and pixels, so the view is painted anew
+    viewport()->update();
+}
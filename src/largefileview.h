@@ -0,0 +1,146 @@
+#ifndef LARGEFILEVIEW_H
+#define LARGEFILEVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QAtomicInt>
+#include <QFile>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include "encodingmanager.h"
+#include "lineindex.h"
+#include "piecetable.h"
+#include "searchindex.h"
+
+/**
+ * @brief Editor for files too large to load into a document
+ *
+ * The file is memory-mapped and never copied: its lines are indexed on a
+ * worker thread, edits go into a PieceTable over the mapping, and only the
+ * lines on screen are decoded, each time they are painted. Memory use is the
+ * line index, the edits and one screenful of text however large the file
+ * is; the pages of the mapping belong to the page cache. Lines that are
+ * already indexed can be browsed while the rest is still being scanned;
+ * editing starts once the index is complete. Unless its encoding was
+ * certain from the start and the end, the file is checked for UTF-8 as it
+ * is indexed, and shown as Latin-1 if it is not.
+ *
+ * Only encodings with single-byte line breaks can be viewed this way
+ * (UTF-8, ASCII and the Latin code pages).
+ */
+class LargeFileView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit LargeFileView(QWidget *parent = nullptr);
+    ~LargeFileView() override;
+
+    // Map fileName and start indexing it; false if it cannot be mapped or
+    // its encoding is not one the view can split into lines
+    bool openFile(const QString &fileName);
+
+    // Write the text to fileName through a temporary file, so the mapping of
+    // the original stays valid; error (may be null) receives the reason
+    bool save(const QString &fileName, QString *error = nullptr);
+
+    QString fileName() const { return file.fileName(); }
+    EncodingManager::Encoding encoding() const { return fileEncoding; }
+    qint64 lineCount() const { return table.lineCount(); }
+    bool isIndexing() const { return indexWorker != nullptr; }
+    bool isModified() const { return table.isModified(); }
+
+    // Select the next (or previous) match of query, wrapping around at the
+    // end of the file. The file is searched on a worker thread; a new search
+    // cancels the one running.
+    void find(const SearchIndex::Query &query, bool forward);
+
+    // Scroll line (0-based) to the top of the view
+    void goToLine(qint64 line);
+
+signals:
+    void indexProgress(int percent);
+    void indexFinished(qint64 lineCount);
+    void searchFinished(bool found);
+    void modificationChanged(bool modified);
+    void encodingChanged(EncodingManager::Encoding encoding);
+
+protected:
+    bool event(QEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void focusInEvent(QFocusEvent *event) override;
+    void focusOutEvent(QFocusEvent *event) override;
+    bool focusNextPrevChild(bool next) override;
+    void changeEvent(QEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private slots:
+    void onIndexWorkerFinished();
+    void onSearchWorkerFinished();
+
+private:
+    QFile file;
+    const char *data;
+    qint64 size;
+    qint64 textStart;     // After the byte order mark, if any
+    QByteArray lineBreak; // "\n" or "\r\n", as the file's first line ends
+    EncodingManager::Encoding fileEncoding;
+    bool validatingEncoding;  // Detection was not certain; the index worker checks every byte
+
+    LineIndex index;      // Of the mapped original
+    PieceTable table;     // The text: the original and the edits
+    QThread *indexWorker;
+    QAtomicInt indexGeneration;  // -1 cancels the worker
+
+    // The cursor; columns count characters of the decoded line
+    qint64 cursorLine;
+    int cursorColumn;
+
+    // The current match, by line start so it can be found before its line
+    // is indexed; matchLine is -1 until then
+    qint64 matchStart;
+    qint64 matchLine;
+    int matchColumn;
+    int matchLength;
+
+    SearchIndex searchIndex;
+    bool searchForward;
+    bool searchPending;  // Waiting for the worker to search for the current request
+    QThread *searchWorker;
+    QAtomicInt searchWorkerGeneration;  // Generation the worker searches for, -1 cancels it
+    int searchWorkerStartedGeneration;
+    int searchGeneration;
+
+    int widestLine;  // Widest line painted so far, for the horizontal range
+
+    void startIndexWorker();
+    void applyIndexChunk(const QVector<qint64> &checkpoints, qint64 lineCount, qint64 end, bool validUtf8);
+    void startSearchWorker();
+    void applySearchResult(qint64 lineStart, int column, int length, int forGeneration);
+    void revealMatch();
+
+    // Editing
+    qint64 lineByteStart(qint64 line) const;
+    qint64 cursorOffset() const;
+    void setCursorOffset(qint64 offset);
+    void moveCursor(qint64 line, int column);
+    void insertText(const QString &text);
+    void deleteBackward();
+    void deleteForward();
+    void undoOrRedo(bool undo);
+    void afterEdit();
+
+    // The line as shown; columnBytes (may be null) receives the byte offset
+    // of every column and of the end, from lineByteStart()
+    QString lineText(qint64 line, QVector<int> *columnBytes = nullptr) const;
+    int columnAt(const QString &text, int x) const;
+    int gutterWidth() const;
+    int visibleLineCount() const;
+    void ensureColumnsVisible(const QString &text, int from, int to);
+    void updateScrollBars();
+};
+
+#endif // LARGEFILEVIEW_H
@@ -0,0 +1,73 @@
+#include "lineindex.h"
+#include <algorithm>
+#include <cstring>
+
+LineIndex::LineIndex(const char *data, qint64 size)
+    : buffer(data)
+    , bufferSize(size)
+    , checkpoints({0})
+    , lines(1)
+    , indexed(0)
+{
+}
+
+qint64 LineIndex::scan(const char *data, qint64 begin, qint64 end, qint64 lineCount,
+                       QVector<qint64> *checkpoints)
+{
+    const char *p = data + begin;
+    const char *stop = data + end;
+    while (p < stop) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', size_t(stop - p)));
+        if (!newline) {
+            break;
+        }
+        if (lineCount % Stride == 0) {
+            checkpoints->append(newline + 1 - data);
+        }
+        ++lineCount;
+        p = newline + 1;
+    }
+    return lineCount;
+}
+
+void LineIndex::extend(const QVector<qint64> &newCheckpoints, qint64 lineCount, qint64 end)
+{
+    checkpoints += newCheckpoints;
+    lines = lineCount;
+    indexed = end;
+}
+
+void LineIndex::build()
+{
+    lines = scan(buffer, indexed, bufferSize, lines, &checkpoints);
+    indexed = bufferSize;
+}
+
+qint64 LineIndex::lineStart(qint64 line) const
+{
+    const char *p = buffer + checkpoints.at(line / Stride);
+    const char *stop = buffer + indexed;
+    for (qint64 skip = line % Stride; skip > 0; --skip) {
+        p = static_cast<const char *>(std::memchr(p, '\n', size_t(stop - p))) + 1;
+    }
+    return p - buffer;
+}
+
+qint64 LineIndex::lineAt(qint64 offset) const
+{
+    // The last checkpoint at or before offset, then the newlines up to it
+    const auto it = std::upper_bound(checkpoints.cbegin(), checkpoints.cend(), offset);
+    const qint64 checkpoint = (it - checkpoints.cbegin()) - 1;
+    qint64 line = checkpoint * Stride;
+    const char *p = buffer + checkpoints.at(checkpoint);
+    const char *stop = buffer + offset;
+    while (p < stop) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', size_t(stop - p)));
+        if (!newline) {
+            break;
+        }
+        ++line;
+        p = newline + 1;
+    }
+    return line;
+}
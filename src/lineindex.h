@@ -0,0 +1,60 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Where the lines of a byte buffer start, at a fixed cost per line
+ *
+ * Only the start of every Stride-th line is stored, so a file of a hundred
+ * million lines needs about 12 MB of index. A lookup starts from the nearest
+ * checkpoint and skips fewer than Stride newlines in the buffer itself. Lines
+ * end at '\n'; a buffer ending in '\n' has an empty last line, as in
+ * QTextDocument.
+ *
+ * The buffer can be indexed piecewise: scan() runs on any thread over a
+ * range of the buffer and extend() adds what it found.
+ */
+class LineIndex
+{
+public:
+    static const int Stride = 64;  // Lines per checkpoint
+
+    LineIndex(const char *data = nullptr, qint64 size = 0);
+
+    const char *data() const { return buffer; }
+    qint64 size() const { return bufferSize; }
+
+    // Scan data[begin, end) given that lineCount lines start before begin.
+    // Appends the starts of the checkpoint lines found to checkpoints and
+    // returns the new line count.
+    static qint64 scan(const char *data, qint64 begin, qint64 end, qint64 lineCount,
+                       QVector<qint64> *checkpoints);
+
+    // Add the result of scanning the bytes from indexedBytes() to end
+    void extend(const QVector<qint64> &checkpoints, qint64 lineCount, qint64 end);
+
+    // Index the rest of the buffer on the calling thread
+    void build();
+
+    bool isComplete() const { return indexed == bufferSize; }
+    qint64 indexedBytes() const { return indexed; }
+    qint64 lineCount() const { return lines; }  // Lines starting in the indexed bytes
+
+    // Offset of the first byte of line, which must be below lineCount()
+    qint64 lineStart(qint64 line) const;
+
+    // Line holding the byte at offset, which must be at most indexedBytes();
+    // this is also the number of line breaks before offset
+    qint64 lineAt(qint64 offset) const;
+
+private:
+    const char *buffer;
+    qint64 bufferSize;
+    QVector<qint64> checkpoints;  // Start of lines 0, Stride, 2 * Stride, ...
+    qint64 lines;
+    qint64 indexed;
+};
+
+#endif // LINEINDEX_H
@@ -3,10 +3,15 @@
 #include <QLocale>
 #include <QDir>
 #include "mainwindow.h"
+#include "startupprofiler.h"
 
 int main(int argc, char *argv[])
 {
+    StartupProfiler &profiler = StartupProfiler::instance();
+    profiler.start(argc, argv);
+
     QApplication app(argc, argv);
+    profiler.mark("create_application");
 
     app.setApplicationName("Eddy");
     app.setApplicationVersion("1.0.0");
@@ -90,6 +95,7 @@ int main(int argc, char *argv[])
         "    color: #4a4a4a;"
         "}"
     );
+    profiler.mark("application_stylesheet");
 
     // Setup internationalization
     QTranslator translator;
@@ -130,8 +136,12 @@ int main(int argc, char *argv[])
         }
     }
 
+    profiler.mark("load_translations");
+
     MainWindow window;
     window.show();
+    profiler.mark("show_window");
+    profiler.watchFirstPaint(&window);
 
     return app.exec();
 }
\ No newline at end of file
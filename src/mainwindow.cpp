@@ -1,11 +1,15 @@
 #include "mainwindow.h"
+#include "startupprofiler.h"
 #include <QTextStream>
 #include <QStringConverter>
 #include <QStandardPaths>
 #include <QToolBar>
 #include <QDebug>
 #include <QFile>
+#include <QFontDatabase>
 #include <QInputDialog>
+#include <QProgressBar>
+#include <QScrollBar>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -17,7 +21,7 @@ MainWindow::MainWindow(QWidget *parent)
       lineCountLabel(nullptr), wordCountLabel(nullptr), characterCountLabel(nullptr), encodingLabel(nullptr),
       cursorPositionLabel(nullptr), selectionInfoLabel(nullptr), fileSizeLabel(nullptr),
       activeTabInfoMap(nullptr), recentFilesMenu(nullptr), currentViewMode(ViewMode::Single), focusedTabWidget(nullptr),
-      projectPanelVisible(false), outlinePanelVisible(false), isSmallScreen(false), autoSaveTimer(nullptr), autoSaveEnabled(true), autoSaveInterval(30), autoSaveAction(nullptr),
+      projectPanelVisible(false), outlinePanelVisible(false), isSmallScreen(false), insertingLoadedText(false), autoSaveTimer(nullptr), autoSaveEnabled(true), autoSaveInterval(30), autoSaveAction(nullptr),
       autoRestoreSessionEnabled(true),
       isDarkTheme(false), themeAction(nullptr), lineWrapEnabled(true), wordWrapMode(true), showColumnRuler(false), showWrapIndicator(true), wrapColumn(80),
       lineWrapAction(nullptr), wordWrapAction(nullptr), columnRulerAction(nullptr), wrapIndicatorAction(nullptr),
@@ -26,30 +30,43 @@ MainWindow::MainWindow(QWidget *parent)
       trimWhitespaceOnSave(true), autoIndentEnabled(true), autoCloseBracketsEnabled(true), smartBackspaceEnabled(true),
       findDialog(nullptr), findInFilesDialog(nullptr), goToLineDialog(nullptr), symbolSearchDialog(nullptr), characterInspector(nullptr), commandPalette(nullptr)
 {
+    StartupProfiler &profiler = StartupProfiler::instance();
+
     detectScreenSize();
 
     // Load theme preference early (before loading stylesheet)
     QSettings settings;
     isDarkTheme = settings.value("isDarkTheme", false).toBool();
+    profiler.mark("read_theme_setting");
 
     loadStyleSheet();
+    profiler.mark("load_stylesheet");
     setupEditor();
+    profiler.mark("setup_editor");
     setupMenus();
+    profiler.mark("setup_menus");
     setupToolBar();
+    profiler.mark("setup_toolbar");
     setupStatusBar();
+    profiler.mark("setup_status_bar");
     setupAutoSave();
     setupResponsiveUI();
+    profiler.mark("setup_responsive_ui");
     loadSettings();
+    profiler.mark("load_settings");
     loadRecentFiles();
+    profiler.mark("load_recent_files");
 
     setWindowTitle(tr("Eddy"));
     resize(800, 600);
 
     // Create first tab
     createNewTab();
+    profiler.mark("create_first_tab");
 
     // Auto-restore session if enabled
     autoRestoreSession();
+    profiler.mark("auto_restore_session");
 }
 
 MainWindow::~MainWindow()
@@ -598,6 +615,27 @@ bool MainWindow::maybeSave()
 
 bool MainWindow::saveDocument(const QString &fileName)
 {
+    // Large files are written from their pieces, in the encoding they have
+    if (LargeFileView *view = getCurrentLargeFileView()) {
+        QString error;
+        if (!view->save(fileName, &error)) {
+            QMessageBox::warning(this, "Eddy",
+                QString("Cannot write file %1:\n%2")
+                .arg(fileName)
+                .arg(error));
+            return false;
+        }
+        setCurrentFile(fileName);
+        return true;
+    }
+
+    // A tab still loading holds only part of its file
+    QWidget *container = tabWidget->currentWidget();
+    if (container && container->findChild<FileLoader*>(QString(), Qt::FindDirectChildrenOnly)) {
+        statusBar()->showMessage(tr("Cannot save while the file is still loading"), 3000);
+        return false;
+    }
+
     CodeEditor *editor = getCurrentEditor();
     if (!editor) return false;
 
@@ -659,6 +697,11 @@ bool MainWindow::saveDocument(const QString &fileName)
 
 void MainWindow::loadFile(const QString &fileName)
 {
+    // Files too large for a document are mapped and edited through a piece table
+    if (QFileInfo(fileName).size() > LargeFileThreshold && openLargeFile(fileName)) {
+        return;
+    }
+
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly)) {
         QMessageBox::warning(this, "Eddy",
@@ -667,36 +710,27 @@ void MainWindow::loadFile(const QString &fileName)
             .arg(file.errorString()));
         return;
     }
-
-    // Read file as raw bytes for encoding detection
-    QByteArray data = file.readAll();
+    const qint64 fileSize = file.size();
     file.close();
 
-    // Detect encoding
-    EncodingManager::Encoding detectedEncoding = EncodingManager::detectEncoding(data);
-
-    // Decode file content using detected encoding
-    QString content = EncodingManager::decode(data, detectedEncoding);
-
     // Create new tab for this file
     createNewTab(fileName);
 
     CodeEditor *editor = getCurrentEditor();
     if (editor) {
-        editor->setPlainText(content);
+        // Large files get the visible lines highlighted first and the rest while idle
+        int currentTabIndex = tabWidget->currentIndex();
+        if (currentTabIndex >= 0 && activeTabInfoMap->contains(currentTabIndex) && (*activeTabInfoMap)[currentTabIndex].highlighter) {
+            (*activeTabInfoMap)[currentTabIndex].highlighter->setLazyHighlighting(fileSize > LazyHighlightThreshold);
+        }
 
         setCurrentFile(fileName);
 
         // Add to recent files
         addToRecentFiles(fileName);
 
-        // Store detected encoding
-        int currentTabIndex = tabWidget->currentIndex();
+        // Auto-detect and set syntax highlighting based on file extension
         if (currentTabIndex >= 0 && activeTabInfoMap->contains(currentTabIndex)) {
-            (*activeTabInfoMap)[currentTabIndex].encoding = detectedEncoding;
-            updateEncodingLabel();
-
-            // Auto-detect and set syntax highlighting based on file extension
             JsonSyntaxHighlighter *highlighter = (*activeTabInfoMap)[currentTabIndex].highlighter;
             if (highlighter) {
                 highlighter->setLanguageFromFilename(fileName);
@@ -716,9 +750,183 @@ void MainWindow::loadFile(const QString &fileName)
                 }
             }
         }
+
+        // The text is read and decoded on a worker thread and shown as it
+        // arrives; the tab stays read-only until all of it is in. The loader
+        // belongs to the tab, so closing the tab cancels it.
+        QWidget *container = tabWidget->currentWidget();
+        FileLoader *loader = new FileLoader(fileName, container);
+        editor->setReadOnly(true);
+        editor->document()->setUndoRedoEnabled(false);
+
+        QProgressBar *progressBar = new QProgressBar();
+        progressBar->setRange(0, 100);
+        progressBar->setTextVisible(false);
+        progressBar->setFixedSize(32, 6);
+        progressBar->setToolTip(tr("Loading; close the tab to cancel"));
+        tabWidget->tabBar()->setTabButton(currentTabIndex, QTabBar::LeftSide, progressBar);
+
+        const QString displayName = QFileInfo(fileName).fileName();
+        connect(loader, &FileLoader::textLoaded, editor, [this, editor](const QString &text, bool replace) {
+            appendLoadedText(editor, text, replace);
+        });
+        connect(loader, &FileLoader::progress, progressBar, &QProgressBar::setValue);
+        connect(loader, &FileLoader::progress, this, [this, displayName](int percent) {
+            statusBar()->showMessage(tr("Loading %1: %2%").arg(displayName).arg(percent));
+        });
+        connect(loader, &FileLoader::finished, this, [this, container, loader]() {
+            finishLoading(container, loader);
+        });
+        connect(loader, &FileLoader::failed, this, [this, container, fileName](const QString &error) {
+            QMessageBox::warning(this, "Eddy",
+                QString("Cannot read file %1:\n%2")
+                .arg(fileName)
+                .arg(error));
+            // Not while the loader, which the tab owns, is emitting
+            QTimer::singleShot(0, container, [this, container]() {
+                closeTab(tabWidget->indexOf(container));
+            });
+        });
+        loader->start();
     }
 }
 
+void MainWindow::appendLoadedText(CodeEditor *editor, const QString &text, bool replace)
+{
+    insertingLoadedText = true;
+    if (replace || editor->document()->isEmpty()) {
+        // Also puts the cursor at the start, where the first chunk is read
+        const int scrollValue = editor->verticalScrollBar()->value();
+        editor->setPlainText(text);
+        editor->verticalScrollBar()->setValue(scrollValue);
+    } else {
+        // A cursor of its own, so the view stays where the user scrolled it
+        QTextCursor cursor(editor->document());
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(text);
+    }
+    insertingLoadedText = false;
+}
+
+void MainWindow::finishLoading(QWidget *container, FileLoader *loader)
+{
+    // Out of the tab at once, so the tab no longer counts as loading
+    loader->setParent(nullptr);
+    loader->deleteLater();
+
+    CodeEditor *editor = container->findChild<CodeEditor*>(QString(), Qt::FindDirectChildrenOnly);
+    if (editor) {
+        editor->document()->setUndoRedoEnabled(true);
+        editor->setReadOnly(false);
+    }
+
+    // The tab may be in the pane that is not active now
+    QTabWidget *tabs = leftTabWidget;
+    QMap<int, TabInfo> *tabInfoMap = &leftTabInfoMap;
+    if (rightTabWidget && rightTabWidget->indexOf(container) >= 0) {
+        tabs = rightTabWidget;
+        tabInfoMap = &rightTabInfoMap;
+    }
+    const int index = tabs->indexOf(container);
+    if (index < 0) {
+        return;
+    }
+
+    if (QWidget *progressBar = tabs->tabBar()->tabButton(index, QTabBar::LeftSide)) {
+        tabs->tabBar()->setTabButton(index, QTabBar::LeftSide, nullptr);
+        progressBar->deleteLater();
+    }
+
+    // Store detected encoding
+    if (tabInfoMap->contains(index)) {
+        (*tabInfoMap)[index].encoding = loader->encoding();
+    }
+    if (container == tabWidget->currentWidget()) {
+        updateEncodingLabel();
+        updateStatusBar();
+    }
+    statusBar()->clearMessage();
+}
+
+void MainWindow::whenTabLoaded(QWidget *container, const std::function<void()> &action)
+{
+    // finishLoading() was connected first, so it runs before action
+    FileLoader *loader = container ? container->findChild<FileLoader*>(QString(), Qt::FindDirectChildrenOnly) : nullptr;
+    if (!loader) {
+        action();
+        return;
+    }
+    connect(loader, &FileLoader::finished, this, action);
+}
+
+bool MainWindow::openLargeFile(const QString &fileName)
+{
+    LargeFileView *view = new LargeFileView();
+    if (!view->openFile(fileName)) {
+        delete view;
+        return false;  // Loaded as a document instead
+    }
+
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPointSize(isSmallScreen ? 9 : 11);
+    view->setFont(font);
+
+    // Same container as an editor tab; it holds no CodeEditor, so the editor
+    // actions leave the tab alone and the view handles its own keys
+    QWidget *container = new QWidget();
+    QHBoxLayout *layout = new QHBoxLayout(container);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+    layout->addWidget(view);
+    container->setLayout(layout);
+
+    int index = tabWidget->addTab(container, QFileInfo(fileName).fileName());
+    (*activeTabInfoMap)[index] = TabInfo(fileName, nullptr, nullptr, view->encoding());
+
+    const QString displayName = QFileInfo(fileName).fileName();
+    connect(view, &LargeFileView::indexProgress, this, [this, displayName](int percent) {
+        statusBar()->showMessage(tr("Indexing %1: %2%").arg(displayName).arg(percent));
+    });
+    connect(view, &LargeFileView::indexFinished, this, [this, displayName](qint64 lineCount) {
+        statusBar()->showMessage(tr("%1: %2 lines").arg(displayName).arg(lineCount), 5000);
+    });
+    connect(view, &LargeFileView::modificationChanged, this, [this, container](bool modified) {
+        // Tabs before it may have closed since, so look the tab up now
+        const int tabIndex = tabWidget->indexOf(container);
+        if (tabIndex >= 0) {
+            setTabModified(tabIndex, modified);
+        }
+    });
+    connect(view, &LargeFileView::encodingChanged, this, [this, container](EncodingManager::Encoding encoding) {
+        // The tab may be in the pane that is not active now
+        QTabWidget *tabs = leftTabWidget;
+        QMap<int, TabInfo> *tabInfoMap = &leftTabInfoMap;
+        if (rightTabWidget && rightTabWidget->indexOf(container) >= 0) {
+            tabs = rightTabWidget;
+            tabInfoMap = &rightTabInfoMap;
+        }
+        const int tabIndex = tabs->indexOf(container);
+        if (tabInfoMap->contains(tabIndex)) {
+            (*tabInfoMap)[tabIndex].encoding = encoding;
+        }
+        if (container == tabWidget->currentWidget()) {
+            updateEncodingLabel();
+        }
+    });
+    connect(view, &LargeFileView::searchFinished, this, [this](bool found) {
+        if (!found) {
+            statusBar()->showMessage(tr("No matches found"), 3000);
+        }
+    });
+
+    tabWidget->setCurrentIndex(index);
+    setCurrentFile(fileName);
+    addToRecentFiles(fileName);
+    updateEncodingLabel();
+    view->setFocus();
+    return true;
+}
+
 void MainWindow::setCurrentFile(const QString &fileName)
 {
     int currentIndex = tabWidget->currentIndex();
@@ -859,13 +1067,14 @@ void MainWindow::createNewTab(const QString &fileName)
     editor->setShowIndentationGuides(indentationGuidesEnabled);
     editor->setHighlightActiveIndent(activeIndentHighlightEnabled);
 
-    // Create syntax highlighter for this tab
+    // Create syntax highlighter for this tab (languages come from the shared registry)
     JsonSyntaxHighlighter *highlighter = new JsonSyntaxHighlighter(editor->document());
-    highlighter->loadLanguages("languages");
     highlighter->setTheme(isDarkTheme);
+    connect(editor, &CodeEditor::visibleBlocksChanged, highlighter, &JsonSyntaxHighlighter::setVisibleBlockRange);
 
     // Create minimap for this tab
     Minimap *minimap = new Minimap(editor);
+    minimap->setShowSyntax(true);
     minimap->setVisible(minimapEnabled);
 
     // Create container widget with editor and minimap
@@ -885,6 +1094,9 @@ void MainWindow::createNewTab(const QString &fileName)
 
     // Connect text changed signal for this editor
     connect(editor, &CodeEditor::textChanged, [this, index]() {
+        if (insertingLoadedText) {
+            return;
+        }
         setTabModified(index, true);
         onTextChanged(); // Trigger auto-save timer reset
         updateStatusBar(); // Update line/word count and other status info
@@ -972,6 +1184,21 @@ CodeEditor* MainWindow::getCurrentEditor()
     return nullptr;
 }
 
+LargeFileView* MainWindow::getCurrentLargeFileView()
+{
+    QWidget *container = tabWidget->currentWidget();
+    if (!container) {
+        return nullptr;
+    }
+
+    QLayout *layout = container->layout();
+    if (layout && layout->count() > 0) {
+        return qobject_cast<LargeFileView*>(layout->itemAt(0)->widget());
+    }
+
+    return nullptr;
+}
+
 CodeEditor* MainWindow::getEditorAt(int index)
 {
     QWidget *container = tabWidget->widget(index);
@@ -1857,23 +2084,38 @@ void MainWindow::openFileFromFindInFiles(const QString &filePath, int lineNumber
     // Open the file
     loadFile(filePath);
 
-    // Jump to the specified line
-    CodeEditor *editor = getCurrentEditor();
-    if (editor && lineNumber > 0) {
-        QTextCursor cursor = editor->textCursor();
-        cursor.movePosition(QTextCursor::Start);
-        cursor.movePosition(QTextCursor::Down, QTextCursor::MoveAnchor, lineNumber - 1);
-        editor->setTextCursor(cursor);
-        editor->centerCursor();
-        editor->setFocus();
-    }
+    // Jump to the specified line once the text is in
+    QWidget *container = tabWidget->currentWidget();
+    whenTabLoaded(container, [this, container, lineNumber]() {
+        CodeEditor *editor = getEditorAt(tabWidget->indexOf(container));
+        if (editor && lineNumber > 0) {
+            QTextCursor cursor = editor->textCursor();
+            cursor.movePosition(QTextCursor::Start);
+            cursor.movePosition(QTextCursor::Down, QTextCursor::MoveAnchor, lineNumber - 1);
+            editor->setTextCursor(cursor);
+            editor->centerCursor();
+            editor->setFocus();
+        }
+    });
 }
 
 void MainWindow::performFind(const QString &text, bool forward, bool caseSensitive, bool wholeWords, bool useRegex)
 {
+    // Large files are searched by their view, on a worker thread
+    if (LargeFileView *view = getCurrentLargeFileView()) {
+        view->find({text, caseSensitive, wholeWords, useRegex}, forward);
+        return;
+    }
+
     CodeEditor *editor = getCurrentEditor();
     if (!editor) return;
 
+    // Minimap overview markers for every match
+    int currentTabIndex = tabWidget->currentIndex();
+    if (activeTabInfoMap->contains(currentTabIndex) && (*activeTabInfoMap)[currentTabIndex].minimap) {
+        (*activeTabInfoMap)[currentTabIndex].minimap->setSearch({text, caseSensitive, wholeWords, useRegex});
+    }
+
     QTextDocument::FindFlags flags = QTextDocument::FindFlags();
     if (!forward) flags |= QTextDocument::FindBackward;
     if (caseSensitive) flags |= QTextDocument::FindCaseSensitively;
@@ -3019,64 +3261,79 @@ void MainWindow::restoreSessionData(const QJsonObject &sessionData)
                 continue;
             }
 
-            // Load the file
+            // Each file loads on a worker of its own, so they all load at once
+            const int tabsBefore = tabWidget->count();
             loadFile(filePath);
+            if (tabWidget->count() == tabsBefore) {
+                continue;
+            }
+
+            // The rest needs the text, so it waits until the file is loaded
+            QWidget *container = tabWidget->currentWidget();
+            whenTabLoaded(container, [this, container, fileData]() {
+                // The other pane may have become active while the file loaded
+                QTabWidget *tabs = leftTabWidget;
+                QMap<int, TabInfo> *tabInfoMap = &leftTabInfoMap;
+                if (rightTabWidget && rightTabWidget->indexOf(container) >= 0) {
+                    tabs = rightTabWidget;
+                    tabInfoMap = &rightTabInfoMap;
+                }
+                const int currentTab = tabs->indexOf(container);
+                if (currentTab < 0) {
+                    return;
+                }
+                CodeEditor *editor = container->findChild<CodeEditor*>(QString(), Qt::FindDirectChildrenOnly);
 
-            int currentTab = tabWidget->currentIndex();
-            if (currentTab >= 0) {
                 // Restore cursor position
-                if (fileData.contains("cursorLine")) {
-                    CodeEditor *editor = getCurrentEditor();
-                    if (editor) {
-                        int line = fileData["cursorLine"].toInt();
-                        int column = fileData["cursorColumn"].toInt();
-
-                        QTextCursor cursor = editor->textCursor();
-                        cursor.movePosition(QTextCursor::Start);
-                        cursor.movePosition(QTextCursor::Down, QTextCursor::MoveAnchor, line);
-                        cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, column);
-                        editor->setTextCursor(cursor);
-                        editor->centerCursor();
-                    }
+                if (fileData.contains("cursorLine") && editor) {
+                    int line = fileData["cursorLine"].toInt();
+                    int column = fileData["cursorColumn"].toInt();
+
+                    QTextCursor cursor = editor->textCursor();
+                    cursor.movePosition(QTextCursor::Start);
+                    cursor.movePosition(QTextCursor::Down, QTextCursor::MoveAnchor, line);
+                    cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, column);
+                    editor->setTextCursor(cursor);
+                    editor->centerCursor();
                 }
 
                 // Restore bookmarks
-                if (fileData.contains("bookmarks")) {
-                    CodeEditor *editor = getCurrentEditor();
-                    if (editor) {
-                        QJsonArray bookmarksArray = fileData["bookmarks"].toArray();
-                        QSet<int> bookmarks;
-                        for (const QJsonValue &bm : bookmarksArray) {
-                            bookmarks.insert(bm.toInt());
-                        }
-                        editor->setBookmarks(bookmarks);
-                        if (activeTabInfoMap->contains(currentTab)) {
-                            (*activeTabInfoMap)[currentTab].bookmarks = bookmarks;
-                        }
+                if (fileData.contains("bookmarks") && editor) {
+                    QJsonArray bookmarksArray = fileData["bookmarks"].toArray();
+                    QSet<int> bookmarks;
+                    for (const QJsonValue &bm : bookmarksArray) {
+                        bookmarks.insert(bm.toInt());
+                    }
+                    editor->setBookmarks(bookmarks);
+                    if (tabInfoMap->contains(currentTab)) {
+                        (*tabInfoMap)[currentTab].bookmarks = bookmarks;
                     }
                 }
 
                 // Restore encoding
-                if (fileData.contains("encoding") && activeTabInfoMap->contains(currentTab)) {
+                if (fileData.contains("encoding") && tabInfoMap->contains(currentTab)) {
                     int encodingValue = fileData["encoding"].toInt();
-                    (*activeTabInfoMap)[currentTab].encoding = static_cast<EncodingManager::Encoding>(encodingValue);
-                    updateEncodingLabel();
+                    (*tabInfoMap)[currentTab].encoding = static_cast<EncodingManager::Encoding>(encodingValue);
+                    if (container == tabWidget->currentWidget()) {
+                        updateEncodingLabel();
+                    }
                 }
 
                 // Restore language
-                if (fileData.contains("language")) {
-                    CodeEditor *editor = getCurrentEditor();
-                    if (editor) {
-                        QString language = fileData["language"].toString();
-                        editor->setCurrentLanguage(language);
-                    }
+                if (fileData.contains("language") && editor) {
+                    QString language = fileData["language"].toString();
+                    editor->setCurrentLanguage(language);
                 }
 
                 // Mark as unmodified if it was saved
                 if (!fileData["modified"].toBool()) {
-                    setTabModified(currentTab, false);
+                    if (tabs == tabWidget) {
+                        setTabModified(currentTab, false);
+                    } else {
+                        tabs->setTabText(currentTab, tabs->tabText(currentTab).replace(" *", ""));
+                    }
                 }
-            }
+            });
         }
 
         // Restore active tab
@@ -39,6 +39,9 @@
 #include "characterinspector.h"
 #include "encodingmanager.h"
 #include "commandpalette.h"
+#include "largefileview.h"
+#include "fileloader.h"
+#include <functional>
 
 enum class ViewMode {
     Single,
@@ -204,6 +207,10 @@ private:
     bool maybeSaveTab(int tabIndex);
     bool saveDocument(const QString &fileName);
     void loadFile(const QString &fileName);
+    bool openLargeFile(const QString &fileName);
+    void appendLoadedText(CodeEditor *editor, const QString &text, bool replace);
+    void finishLoading(QWidget *container, FileLoader *loader);
+    void whenTabLoaded(QWidget *container, const std::function<void()> &action);
     void setCurrentFile(const QString &fileName);
 
     // Tab management
@@ -213,6 +220,7 @@ private:
     void closeAllTabs();
     CodeEditor* getCurrentEditor();
     CodeEditor* getEditorAt(int index);
+    LargeFileView* getCurrentLargeFileView();
     QString getFilePathAt(int index);
     void setFilePathAt(int index, const QString &filePath);
     bool isTabModified(int index);
@@ -295,6 +303,8 @@ private:
     QStringList recentFiles;
     QMenu *recentFilesMenu;
     static const int MaxRecentFiles = 10;
+    static const int LazyHighlightThreshold = 1024 * 1024;  // Files larger than this (bytes) are highlighted lazily
+    static const qint64 LargeFileThreshold = 64 * 1024 * 1024;  // Files larger than this (bytes) open in a LargeFileView
 
     // State
     ViewMode currentViewMode;
@@ -302,6 +312,7 @@ private:
     bool projectPanelVisible;
     bool outlinePanelVisible;
     bool isSmallScreen;
+    bool insertingLoadedText;  // Text arriving from a FileLoader is no edit
 
     // Auto-save components
     QTimer *autoSaveTimer;
@@ -1,26 +1,79 @@
 #include "minimap.h"
 #include "codeeditor.h"
+#include "minimaprenderer.h"
 #include <QPainter>
 #include <QScrollBar>
 #include <QTextBlock>
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QDebug>
 
+namespace {
+
+// Rows merged between checks for a newer mapping
+const int WorkerSliceRows = 128;
+
+// Time budget of one chunk of the summary build, short enough not to drop a frame
+const int SummaryChunkMs = 8;
+
+// Lines summarized between checks of the time budget
+const int SummaryCheckLines = 256;
+
+const QColor SearchHitColor(255, 152, 0);
+const QColor BookmarkColor(66, 135, 245);  // Same blue as the gutter bookmark
+const QColor ModifiedColor(76, 175, 80);
+
+} // namespace
+
 Minimap::Minimap(CodeEditor *editor, QWidget *parent)
     : QWidget(parent)
     , editor(editor)
     , minimapWidth(120)
     , showSyntax(false)
+    , imageBlockCount(-1)
+    , dirtyFirst(-1)
+    , dirtyLast(-1)
+    , summariesValid(false)
+    , summarizedLines(-1)
+    , adoptBaseline(false)
+    , rowsPending(false)
+    , worker(nullptr)
+    , workerGeneration(-1)
+    , workerStartedGeneration(-1)
+    , generation(0)
+    , lastRevision(editor->document()->revision())
+    , searchPending(false)
+    , searchWorker(nullptr)
+    , searchWorkerGeneration(-1)
+    , searchWorkerStartedGeneration(-1)
+    , searchGeneration(0)
 {
     setMinimumWidth(minimapWidth);
     setMaximumWidth(minimapWidth);
 
-    // Connect to editor signals
-    connect(editor, &QPlainTextEdit::textChanged, this, &Minimap::onEditorTextChanged);
+    // Rebuilds after line insertions and removals wait until typing pauses
+    rebuildTimer = new QTimer(this);
+    rebuildTimer->setSingleShot(true);
+    rebuildTimer->setInterval(150);
+    connect(rebuildTimer, &QTimer::timeout, this, [this]() {
+        rebuildImage();
+        update();
+    });
+
+    // Summaries are built a chunk at a time whenever the event loop is idle
+    summaryTimer = new QTimer(this);
+    summaryTimer->setSingleShot(true);
+    summaryTimer->setInterval(0);
+    connect(summaryTimer, &QTimer::timeout, this, &Minimap::summarizeChunk);
+
+    // Connect to editor signals; contentsChange also reports format changes
+    connect(editor->document(), &QTextDocument::contentsChange, this, &Minimap::onContentsChange);
     connect(editor->verticalScrollBar(), &QScrollBar::valueChanged, this, &Minimap::onEditorScrolled);
     connect(editor, &QPlainTextEdit::cursorPositionChanged, this, &Minimap::updateMinimap);
+    connect(editor->document(), &QTextDocument::modificationChanged, this, &Minimap::onModificationChanged);
+    connect(editor, &CodeEditor::bookmarksChanged, this, &Minimap::onBookmarksChanged);
 
     // Enable mouse tracking for hover effects
     setMouseTracking(true);
@@ -32,9 +85,28 @@ Minimap::Minimap(CodeEditor *editor, QWidget *parent)
     setPalette(pal);
 }
 
+Minimap::~Minimap()
+{
+    workerGeneration.storeRelaxed(-1);
+    if (worker) {
+        worker->wait();
+        delete worker;
+    }
+    searchWorkerGeneration.storeRelaxed(-1);
+    if (searchWorker) {
+        searchWorker->wait();
+        delete searchWorker;
+    }
+}
+
 void Minimap::setShowSyntax(bool show)
 {
+    if (showSyntax == show) {
+        return;
+    }
     showSyntax = show;
+    invalidateSummaries();
+    imageBlockCount = -1;  // Redraw every row on the next paint
     update();
 }
 
@@ -43,7 +115,23 @@ void Minimap::setWidth(int width)
     minimapWidth = width;
     setMinimumWidth(width);
     setMaximumWidth(width);
-    update();
+    update();  // The size change rebuilds the image on the next paint
+}
+
+void Minimap::setSearch(const SearchIndex::Query &query)
+{
+    if (query == searchIndex.query()) {
+        return;
+    }
+    searchIndex = SearchIndex(query);
+
+    // Without summaries the query is applied when they are built; a build
+    // under way has matched its first lines against the old query
+    if (summariesValid) {
+        requestSearch();
+    } else if (isSummarizing()) {
+        searchPending = true;
+    }
 }
 
 QSize Minimap::sizeHint() const
@@ -53,18 +141,25 @@ QSize Minimap::sizeHint() const
 
 void Minimap::paintEvent(QPaintEvent *event)
 {
+    Q_UNUSED(event);
+
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing, false); // Faster rendering
 
-    // Fill background
-    painter.fillRect(rect(), QColor(250, 250, 250));
-
     if (!editor) {
+        painter.fillRect(rect(), QColor(250, 250, 250));
         return;
     }
 
-    // Draw the document
-    drawDocument(painter);
+    // Bring the cached image up to date, then blit it
+    const bool remapped = imageBlockCount != editor->document()->blockCount();
+    if (image.size() != size() || (remapped && !rebuildTimer->isActive())) {
+        rebuildImage();
+    } else if (dirtyFirst >= 0 && !rowsPending) {
+        redrawLines(dirtyFirst, dirtyLast);
+    }
+    painter.drawImage(0, 0, image);
+    drawMarkers(painter);
 
     // Draw visible region overlay
     drawVisibleRegion(painter);
@@ -74,53 +169,536 @@ void Minimap::paintEvent(QPaintEvent *event)
     painter.drawLine(0, 0, 0, height());
 }
 
-void Minimap::drawDocument(QPainter &painter)
+void Minimap::onContentsChange(int position, int charsRemoved, int charsAdded)
 {
+    Q_UNUSED(charsRemoved);
+
     QTextDocument *doc = editor->document();
-    if (!doc) {
+    const bool textChanged = doc->revision() != lastRevision;
+    lastRevision = doc->revision();
+
+    const int first = doc->findBlock(position).blockNumber();
+    int last = doc->findBlock(position + charsAdded).blockNumber();
+    if (first < 0) {
         return;
     }
+    if (last < 0) {
+        last = doc->blockCount() - 1;
+    }
 
-    int totalLines = doc->blockCount();
-    if (totalLines == 0) {
+    // Clean hashes and summaries, once built, follow every edit so markers
+    // stay on their lines
+    syncCleanHashes(first, last);
+    if (summariesValid || isSummarizing()) {
+        syncLineSummaries(first, last);
+    }
+    if (textChanged && searchPending && summariesValid) {
+        requestSearch();  // The worker's snapshot is out of date
+    }
+
+    // Hidden minimaps only note that they must rebuild when shown
+    if (!isVisible()) {
+        imageBlockCount = -1;
         return;
     }
 
-    // Calculate scale factor
-    double scaleFactor = getScaleFactor();
-    int charWidth = 1; // Minimap character width (very small)
-    int lineHeight = 1; // Minimap line height (1 pixel per line for dense view)
+    if (doc->blockCount() != imageBlockCount || (!summariesValid && !isSummarizing())) {
+        // Every row maps to different lines now; keep showing the old image until then
+        rebuildTimer->start();
+        return;
+    }
 
-    // Draw each line as a simplified representation
-    QTextBlock block = doc->begin();
-    int lineNumber = 0;
+    dirtyFirst = dirtyFirst < 0 ? first : qMin(dirtyFirst, first);
+    dirtyLast = qMax(dirtyLast, last);
+    update();
+}
+
+void Minimap::syncLineSummaries(int firstLine, int lastLine)
+{
+    QTextDocument *doc = editor->document();
+    const int oldCount = int(lineSummaries.size());
+    if (firstLine > oldCount) {
+        invalidateSummaries();
+        return;
+    }
+
+    // Lines firstLine..lastLine replace firstLine..lastLine - delta of the old text
+    const int delta = doc->blockCount() - oldCount;
+    const int replaced = qBound(0, lastLine - delta - firstLine + 1, oldCount - firstLine);
+    const int inserted = lastLine - firstLine + 1;
+
+    // Only the difference moves the tail; the rest is overwritten in place,
+    // so format changes and edits within a line cost nothing per line
+    if (inserted > replaced) {
+        lineSummaries.insert(firstLine + replaced, inserted - replaced, MinimapRenderer::Summary());
+    } else if (inserted < replaced) {
+        lineSummaries.remove(firstLine + inserted, replaced - inserted);
+    }
+    if (lineSummaries.size() != doc->blockCount() || cleanHashes.size() != lineSummaries.size()) {
+        invalidateSummaries();
+        return;
+    }
+
+    // A build under way reaches the edit later, or moves on past it now
+    if (isSummarizing()) {
+        if (summarizedLines <= firstLine) {
+            return;
+        }
+        summarizedLines = qMax(lastLine + 1, summarizedLines + delta);
+    }
+
+    QTextBlock block = doc->findBlockByNumber(firstLine);
+    for (int line = firstLine; line <= lastLine && block.isValid(); ++line, block = block.next()) {
+        MinimapRenderer::Summary summary = MinimapRenderer::summarizeLine(block, showSyntax);
+        summary.markers = markersOf(block, line, summary);
+        lineSummaries[line] = summary;
+    }
+}
+
+void Minimap::syncCleanHashes(int firstLine, int lastLine)
+{
+    // Kept apart from the summaries so a rebuild does not lose the clean text
+    const int oldCount = int(cleanHashes.size());
+    if (oldCount == 0) {
+        return;
+    }
+    if (firstLine > oldCount) {
+        cleanHashes.clear();
+        return;
+    }
+
+    // New lines take over the clean hashes of the lines they replace, in order
+    const int delta = editor->document()->blockCount() - oldCount;
+    const int replaced = qBound(0, lastLine - delta - firstLine + 1, oldCount - firstLine);
+    const int inserted = lastLine - firstLine + 1;
+    if (inserted > replaced) {
+        cleanHashes.insert(firstLine + replaced, inserted - replaced, 0u);
+    } else if (inserted < replaced) {
+        cleanHashes.remove(firstLine + inserted, replaced - inserted);
+    }
+    if (cleanHashes.size() != editor->document()->blockCount()) {
+        cleanHashes.clear();
+    }
+}
+
+void Minimap::startSummaries()
+{
+    const int lineCount = editor->document()->blockCount();
+    lineSummaries.fill(MinimapRenderer::Summary(), lineCount);
+    summarizedLines = 0;
+
+    // Without a known clean text the current one stands in for it, so
+    // nothing is marked modified that was not edited since
+    adoptBaseline = cleanHashes.size() != lineCount;
+    if (adoptBaseline) {
+        cleanHashes.fill(0u, lineCount);
+    }
+
+    // The build matches the current query on every line itself
+    ++searchGeneration;
+    searchPending = false;
+    searchWorkerGeneration.storeRelaxed(-1);
+
+    summaryTimer->start();
+}
+
+void Minimap::summarizeChunk()
+{
+    QTextDocument *doc = editor->document();
+    const int lineCount = doc->blockCount();
+    if (!isSummarizing() || lineSummaries.size() != lineCount || cleanHashes.size() != lineCount) {
+        invalidateSummaries();
+        imageBlockCount = -1;  // Start over on the next paint
+        update();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const int firstLine = summarizedLines;
+    int line = firstLine;
+    for (QTextBlock block = doc->findBlockByNumber(line); block.isValid(); block = block.next()) {
+        MinimapRenderer::Summary summary = MinimapRenderer::summarizeLine(block, showSyntax);
+        if (adoptBaseline) {
+            cleanHashes[line] = summary.textHash;
+        }
+        summary.markers = markersOf(block, line, summary);
+        lineSummaries[line] = summary;
+        if (++line % SummaryCheckLines == 0 && timer.hasExpired(SummaryChunkMs)) {
+            break;
+        }
+    }
+    summarizedLines = line;
+
+    // Rows of the lines summarized so far are drawn while the rest waits;
+    // a pending remap draws them itself
+    if (imageBlockCount == lineCount && isDownsampled() && !rowsPending && line > firstLine) {
+        mergeRows(documentLineToMinimapY(firstLine), documentLineToMinimapY(line - 1));
+    }
+
+    if (line < lineCount) {
+        summaryTimer->start();
+    } else {
+        summarizedLines = -1;
+        adoptBaseline = false;
+        summariesValid = true;
+
+        // A query set during the build has to be matched on every line
+        if (searchPending) {
+            requestSearch();
+        }
+    }
+    update();
+}
+
+void Minimap::invalidateSummaries()
+{
+    summariesValid = false;
+    summarizedLines = -1;
+    adoptBaseline = false;
+    summaryTimer->stop();
+}
+
+quint8 Minimap::markersOf(const QTextBlock &block, int line, const MinimapRenderer::Summary &summary) const
+{
+    quint8 markers = 0;
+    if (line < cleanHashes.size() && summary.textHash != cleanHashes.at(line)) {
+        markers |= MinimapRenderer::Modified;
+    }
+    if (!searchIndex.query().isEmpty() && searchIndex.matches(block.text())) {
+        markers |= MinimapRenderer::SearchHit;
+    }
+    return markers;
+}
+
+void Minimap::markersChanged()
+{
+    // Detailed images draw markers straight from the line summaries
+    if (isVisible() && imageBlockCount >= 0 && isDownsampled()) {
+        requestRowSummaries();
+    }
+    update();
+}
+
+void Minimap::onModificationChanged(bool modified)
+{
+    if (modified) {
+        return;
+    }
+
+    // Without summaries the next build takes the current text as clean
+    if (!summariesValid && !isSummarizing()) {
+        cleanHashes.clear();
+        return;
+    }
+
+    // A build under way takes the lines it has not reached yet as they come
+    if (!summariesValid) {
+        for (int line = 0; line < summarizedLines; ++line) {
+            MinimapRenderer::Summary &summary = lineSummaries[line];
+            cleanHashes[line] = summary.textHash;
+            summary.markers &= ~MinimapRenderer::Modified;
+        }
+        for (MinimapRenderer::Summary &row : rowSummaries) {
+            row.markers &= ~MinimapRenderer::Modified;
+        }
+        adoptBaseline = true;
+        update();
+        return;
+    }
+
+    // The current text is the new clean state
+    for (int line = 0; line < lineSummaries.size(); ++line) {
+        MinimapRenderer::Summary &summary = lineSummaries[line];
+        cleanHashes[line] = summary.textHash;
+        summary.markers &= ~MinimapRenderer::Modified;
+    }
+    markersChanged();
+}
+
+void Minimap::onBookmarksChanged()
+{
+    // Drawn over the image from the editor's own set
+    update();
+}
+
+void Minimap::requestSearch()
+{
+    ++searchGeneration;
+    searchPending = true;
+    searchWorkerGeneration.storeRelaxed(searchGeneration);
+
+    // A running search is cancelled; onSearchWorkerFinished starts the next one
+    if (!searchWorker) {
+        startSearchWorker();
+    }
+}
+
+void Minimap::startSearchWorker()
+{
+    // One contiguous copy of the text, blocks separated by U+2029
+    const QString snapshot = editor->document()->toRawText();
+    const SearchIndex::Query query = searchIndex.query();
+    const int forGeneration = searchGeneration;
+    searchWorkerStartedGeneration = forGeneration;
+
+    searchWorker = QThread::create([this, snapshot, query, forGeneration]() {
+        const SearchIndex index(query);
+        const QVector<int> lines = index.matchingLines(snapshot, [this, forGeneration]() {
+            return searchWorkerGeneration.loadRelaxed() != forGeneration;
+        });
+        if (searchWorkerGeneration.loadRelaxed() != forGeneration) {
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, lines, forGeneration]() {
+            applySearchHits(lines, forGeneration);
+        }, Qt::QueuedConnection);
+    });
+    connect(searchWorker, &QThread::finished, this, &Minimap::onSearchWorkerFinished);
+    searchWorker->start(QThread::LowPriority);
+}
+
+void Minimap::onSearchWorkerFinished()
+{
+    if (searchWorker) {
+        searchWorker->deleteLater();
+        searchWorker = nullptr;
+    }
+
+    if (searchPending && searchWorkerStartedGeneration != searchGeneration) {
+        startSearchWorker();
+    }
+}
+
+void Minimap::applySearchHits(const QVector<int> &lines, int forGeneration)
+{
+    if (forGeneration != searchGeneration || !summariesValid) {
+        return;
+    }
+    searchPending = false;
+
+    for (MinimapRenderer::Summary &summary : lineSummaries) {
+        summary.markers &= ~MinimapRenderer::SearchHit;
+    }
+    for (int line : lines) {
+        if (line < lineSummaries.size()) {
+            lineSummaries[line].markers |= MinimapRenderer::SearchHit;
+        }
+    }
+    markersChanged();
+}
+
+void Minimap::rebuildImage()
+{
+    rebuildTimer->stop();
+
+    QTextDocument *doc = editor->document();
+    imageBlockCount = doc->blockCount();
+    dirtyFirst = -1;
+    dirtyLast = -1;
+    if (!summariesValid && !isSummarizing()) {
+        startSummaries();
+    }
+
+    const bool resized = image.size() != size();
+    if (resized) {
+        image = QImage(size(), QImage::Format_RGB32);
+        image.fill(MinimapRenderer::Background);
+    }
+    if (image.isNull()) {
+        return;
+    }
 
-    while (block.isValid()) {
-        if (!block.isVisible()) {
-            block = block.next();
-            lineNumber++;
-            continue;
+    if (isDownsampled() && summariesValid) {
+        requestRowSummaries();
+        return;
+    }
+    ++generation;
+    rowsPending = false;
+    workerGeneration.storeRelaxed(-1);
+
+    // While the summaries are built, each chunk draws the rows it completes
+    if (isDownsampled()) {
+        rowSummaries.fill(MinimapRenderer::Summary(), image.height());
+        if (summarizedLines > 0) {
+            mergeRows(0, documentLineToMinimapY(summarizedLines - 1));
         }
+        return;
+    }
 
-        int y = documentLineToMinimapY(lineNumber);
+    // Few enough lines for one row each: draw them in full detail
+    image.fill(MinimapRenderer::Background);
 
-        if (y >= 0 && y < height()) {
-            QString lineText = block.text();
-            int textLength = qMin(lineText.length(), minimapWidth / charWidth);
+    const int width = image.width();
+    int lineNumber = 0;
+    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next(), ++lineNumber) {
+        const int y = documentLineToMinimapY(lineNumber);
+        if (y >= 0 && y < image.height()) {
+            MinimapRenderer::drawLine(reinterpret_cast<QRgb *>(image.scanLine(y)), width, block, showSyntax);
+        }
+    }
+}
 
-            if (textLength > 0) {
-                // Draw simplified line representation
-                // For now, just draw a gray bar for non-empty lines
-                int barWidth = qMin(textLength * charWidth, minimapWidth - 4);
+void Minimap::requestRowSummaries()
+{
+    ++generation;
+    rowsPending = true;
+    workerGeneration.storeRelaxed(generation);
 
-                if (!lineText.trimmed().isEmpty()) {
-                    painter.fillRect(2, y, barWidth, lineHeight, QColor(100, 100, 100, 50));
-                }
+    // A running worker is cancelled; onWorkerFinished starts the next one
+    if (!worker) {
+        startWorker();
+    }
+}
+
+void Minimap::startWorker()
+{
+    // The copy shares the summaries until the next edit detaches them
+    const QVector<MinimapRenderer::Summary> lines = lineSummaries;
+    const int rowCount = image.height();
+    const int forGeneration = generation;
+    workerStartedGeneration = forGeneration;
+
+    worker = QThread::create([this, lines, rowCount, forGeneration]() {
+        QVector<MinimapRenderer::Summary> rows(rowCount);
+        for (int first = 0; first < rowCount; first += WorkerSliceRows) {
+            if (workerGeneration.loadRelaxed() != forGeneration) {
+                return;
             }
+            const int last = qMin(rowCount, first + WorkerSliceRows) - 1;
+            MinimapRenderer::summarizeRows(lines, rowCount, first, last, rows.data() + first);
+        }
+        QMetaObject::invokeMethod(this, [this, rows, forGeneration]() {
+            applyRowSummaries(rows, forGeneration);
+        }, Qt::QueuedConnection);
+    });
+    connect(worker, &QThread::finished, this, &Minimap::onWorkerFinished);
+    worker->start(QThread::LowPriority);
+}
+
+void Minimap::onWorkerFinished()
+{
+    if (worker) {
+        worker->deleteLater();
+        worker = nullptr;
+    }
+
+    if (rowsPending && workerStartedGeneration != generation) {
+        startWorker();
+    }
+}
+
+void Minimap::applyRowSummaries(const QVector<MinimapRenderer::Summary> &rows, int forGeneration)
+{
+    if (forGeneration != generation || rows.size() != image.height()) {
+        return;
+    }
+    rowsPending = false;
+    rowSummaries = rows;
+
+    const int width = image.width();
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *row = reinterpret_cast<QRgb *>(image.scanLine(y));
+        MinimapRenderer::clearRow(row, width);
+        MinimapRenderer::drawRow(row, width, rowSummaries.at(y));
+    }
+
+    // Edits made while the worker ran are redrawn from the current summaries
+    update();
+}
+
+void Minimap::redrawLines(int firstLine, int lastLine)
+{
+    dirtyFirst = -1;
+    dirtyLast = -1;
+
+    QTextDocument *doc = editor->document();
+    const int totalLines = doc->blockCount();
+    const int firstRow = qMax(0, documentLineToMinimapY(firstLine));
+    const int lastRow = qMin(image.height() - 1, documentLineToMinimapY(lastLine));
+    if (totalLines == 0 || firstRow > lastRow) {
+        return;
+    }
+
+    // Downsampled: merge the changed rows again from the line summaries
+    if (isDownsampled()) {
+        mergeRows(firstRow, lastRow);
+        return;
+    }
+
+    const int width = image.width();
+    for (int y = firstRow; y <= lastRow; ++y) {
+        MinimapRenderer::clearRow(reinterpret_cast<QRgb *>(image.scanLine(y)), width);
+    }
+
+    // Redraw every line sharing the rows, not just the changed ones
+    int lineNumber = MinimapRenderer::firstLineOfRow(firstRow, totalLines, image.height());
+    for (QTextBlock block = doc->findBlockByNumber(lineNumber); block.isValid(); block = block.next(), ++lineNumber) {
+        const int y = documentLineToMinimapY(lineNumber);
+        if (y > lastRow) {
+            break;
+        }
+        MinimapRenderer::drawLine(reinterpret_cast<QRgb *>(image.scanLine(y)), width, block, showSyntax);
+    }
+}
+
+void Minimap::mergeRows(int firstRow, int lastRow)
+{
+    firstRow = qMax(0, firstRow);
+    lastRow = qMin(image.height() - 1, lastRow);
+    if (rowSummaries.size() != image.height() || firstRow > lastRow) {
+        return;
+    }
+
+    const int width = image.width();
+    MinimapRenderer::summarizeRows(lineSummaries, image.height(), firstRow, lastRow, rowSummaries.data() + firstRow);
+    for (int y = firstRow; y <= lastRow; ++y) {
+        QRgb *row = reinterpret_cast<QRgb *>(image.scanLine(y));
+        MinimapRenderer::clearRow(row, width);
+        MinimapRenderer::drawRow(row, width, rowSummaries.at(y));
+    }
+}
+
+void Minimap::drawMarkers(QPainter &painter)
+{
+    // Bookmarks are numbered by line in the editor and do not move with
+    // edits, so they come from there rather than from the summaries
+    const int right = width();
+    const QSet<int> bookmarks = editor->getBookmarks();
+    for (int line : bookmarks) {
+        painter.fillRect(right - 12, documentLineToMinimapY(line), 5, 2, BookmarkColor);
+    }
+
+    if (!summariesValid && !isSummarizing()) {
+        return;
+    }
+
+    // Modified lines along the left edge, search hits on the right
+    auto drawRowMarkers = [&](int y, quint8 markers) {
+        if (markers & MinimapRenderer::Modified) {
+            painter.fillRect(1, y, 2, 1, ModifiedColor);
+        }
+        if (markers & MinimapRenderer::SearchHit) {
+            painter.fillRect(right - 6, y, 5, 2, SearchHitColor);
         }
+    };
 
-        block = block.next();
-        lineNumber++;
+    // One pass over the rows, or over the lines when each has its own row
+    if (isDownsampled()) {
+        if (rowSummaries.size() != image.height()) {
+            return;
+        }
+        for (int y = 0; y < rowSummaries.size(); ++y) {
+            if (rowSummaries.at(y).markers) {
+                drawRowMarkers(y, rowSummaries.at(y).markers);
+            }
+        }
+    } else if (lineSummaries.size() <= image.height()) {
+        for (int line = 0; line < lineSummaries.size(); ++line) {
+            if (lineSummaries.at(line).markers) {
+                drawRowMarkers(documentLineToMinimapY(line), lineSummaries.at(line).markers);
+            }
+        }
     }
 }
 
@@ -207,26 +785,6 @@ int Minimap::minimapYToDocumentLine(int y) const
     return qBound(0, (int)(ratio * totalLines), totalLines - 1);
 }
 
-double Minimap::getScaleFactor() const
-{
-    if (!editor) {
-        return 1.0;
-    }
-
-    QTextDocument *doc = editor->document();
-    if (!doc) {
-        return 1.0;
-    }
-
-    int totalLines = doc->blockCount();
-    if (totalLines == 0) {
-        return 1.0;
-    }
-
-    // Calculate how many lines fit in the minimap height
-    return (double)height() / (double)totalLines;
-}
-
 void Minimap::mousePressEvent(QMouseEvent *event)
 {
     if (!editor) {
@@ -272,8 +830,3 @@ void Minimap::onEditorScrolled()
 {
     update();
 }
-
-void Minimap::onEditorTextChanged()
-{
-    update();
-}
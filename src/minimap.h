@@ -2,8 +2,16 @@
 #define MINIMAP_H
 
 #include <QWidget>
+#include <QAtomicInt>
+#include <QImage>
 #include <QPlainTextEdit>
+#include <QSet>
 #include <QTextDocument>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include "minimaprenderer.h"
+#include "searchindex.h"
 
 class CodeEditor;
 
@@ -13,11 +21,15 @@ class Minimap : public QWidget
 
 public:
     explicit Minimap(CodeEditor *editor, QWidget *parent = nullptr);
+    ~Minimap() override;
 
     // Configuration
     void setShowSyntax(bool show);
     void setWidth(int width);
 
+    // Mark the lines matching query; an empty query clears the markers
+    void setSearch(const SearchIndex::Query &query);
+
     QSize sizeHint() const override;
 
 protected:
@@ -29,20 +41,89 @@ protected:
 private slots:
     void updateMinimap();
     void onEditorScrolled();
-    void onEditorTextChanged();
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void rebuildImage();
+    void summarizeChunk();
+    void onWorkerFinished();
+    void onSearchWorkerFinished();
+    void onModificationChanged(bool modified);
+    void onBookmarksChanged();
 
 private:
     CodeEditor *editor;
     int minimapWidth;
     bool showSyntax;
 
+    // The document rendered at one row per widget pixel row. Edits redraw
+    // only the rows of the changed lines; a change in line count remaps
+    // every row and rebuilds the image once the edits pause.
+    QImage image;
+    int imageBlockCount;  // Block count the row mapping was computed for
+    int dirtyFirst;       // Lines whose rows need redrawing, -1 if none
+    int dirtyLast;
+    QTimer *rebuildTimer;
+
+    // Documents with more lines than rows are drawn from summaries: one per
+    // line, kept in step with edits, merged into one per row. A new row
+    // mapping is merged on a worker thread; the old image stays up until the
+    // result arrives, and results for an outdated mapping are dropped.
+    // Summaries need the highlighter's layout formats, so they are built on
+    // the GUI thread in short chunks while it is idle; rows are drawn as
+    // their lines are summarized.
+    QVector<MinimapRenderer::Summary> lineSummaries;
+    bool summariesValid;
+    int summarizedLines;  // Lines summarized by the build under way, -1 if none
+    bool adoptBaseline;   // The build takes the current text as clean
+    QTimer *summaryTimer;
+    QVector<MinimapRenderer::Summary> rowSummaries;
+    bool rowsPending;             // Waiting for the worker to merge the current mapping
+    QThread *worker;
+    QAtomicInt workerGeneration;  // Generation the worker merges for, -1 cancels it
+    int workerStartedGeneration;
+    int generation;               // Bumped for every new row mapping
+
+    void syncCleanHashes(int firstLine, int lastLine);
+    void syncLineSummaries(int firstLine, int lastLine);
+    void startSummaries();
+    void invalidateSummaries();
+    bool isSummarizing() const { return summarizedLines >= 0; }
+    void requestRowSummaries();
+    void startWorker();
+    void applyRowSummaries(const QVector<MinimapRenderer::Summary> &rows, int forGeneration);
+    bool isDownsampled() const { return imageBlockCount > image.height(); }
+
+    // Search and modified markers live in the line summaries, so they move
+    // with inserted and removed lines and merge into rows like the rest of
+    // the summary; bookmarks are drawn from the editor's set. A line
+    // is modified while its text hash differs from the one it had when the
+    // document was last unmodified (0 for lines added since); the hashes
+    // follow every edit, also while the summaries are out of date.
+    QVector<uint> cleanHashes;
+    int lastRevision;  // Tells text edits from format-only changes
+
+    // Search hits are found on a worker thread from a snapshot of the text;
+    // after that only changed lines are matched again
+    SearchIndex searchIndex;
+    bool searchPending;
+    QThread *searchWorker;
+    QAtomicInt searchWorkerGeneration;
+    int searchWorkerStartedGeneration;
+    int searchGeneration;
+
+    quint8 markersOf(const QTextBlock &block, int line, const MinimapRenderer::Summary &summary) const;
+    void markersChanged();
+    void requestSearch();
+    void startSearchWorker();
+    void applySearchHits(const QVector<int> &lines, int forGeneration);
+
     // Rendering helpers
-    void drawDocument(QPainter &painter);
+    void redrawLines(int firstLine, int lastLine);
+    void mergeRows(int firstRow, int lastRow);
+    void drawMarkers(QPainter &painter);
     void drawVisibleRegion(QPainter &painter);
     QRect getVisibleRegionRect() const;
     int documentLineToMinimapY(int lineNumber) const;
     int minimapYToDocumentLine(int y) const;
-    double getScaleFactor() const;
 };
 
 #endif // MINIMAP_H
@@ -0,0 +1,205 @@
+#include "minimaprenderer.h"
+#include "blockdata.h"
+#include <QHash>
+#include <QTextLayout>
+#include <QVarLengthArray>
+#include <algorithm>
+
+namespace {
+
+const int LeftMargin = 2;
+const QRgb BarColor = qPremultiply(qRgba(100, 100, 100, 50));
+const int SyntaxAlpha = 160;
+const QRgb PlainTextColor = qPremultiply(qRgba(100, 100, 100, SyntaxAlpha));
+
+// Premultiplied source over an opaque destination
+inline QRgb blend(QRgb destination, QRgb source)
+{
+    const int inverse = 255 - qAlpha(source);
+    return qRgb(qRed(source) + qRed(destination) * inverse / 255,
+                qGreen(source) + qGreen(destination) * inverse / 255,
+                qBlue(source) + qBlue(destination) * inverse / 255);
+}
+
+// Colour of a format run at minimap opacity, or 0 if it leaves the text colour alone
+inline QRgb runColor(const QTextLayout::FormatRange &range)
+{
+    const QBrush foreground = range.format.foreground();
+    if (foreground.style() == Qt::NoBrush) {
+        return 0;
+    }
+    const QRgb rgb = foreground.color().rgb();
+    return qPremultiply(qRgba(qRed(rgb), qGreen(rgb), qBlue(rgb), SyntaxAlpha));
+}
+
+// Colours seen on one row and how many columns each covers
+struct ColorWeights {
+    static const int Capacity = 8;
+    QRgb colors[Capacity];
+    int weights[Capacity];
+    int count = 0;
+
+    void add(QRgb color, int weight)
+    {
+        for (int i = 0; i < count; ++i) {
+            if (colors[i] == color) {
+                weights[i] += weight;
+                return;
+            }
+        }
+        if (count < Capacity) {
+            colors[count] = color;
+            weights[count++] = weight;
+        }
+    }
+
+    QRgb dominant() const
+    {
+        int best = 0;
+        for (int i = 1; i < count; ++i) {
+            if (weights[i] > weights[best]) {
+                best = i;
+            }
+        }
+        return count > 0 ? colors[best] : 0;
+    }
+};
+
+} // namespace
+
+const QRgb MinimapRenderer::Background = qRgb(250, 250, 250);
+
+int MinimapRenderer::rowOfLine(int line, int lineCount, int rowCount)
+{
+    return int(double(line) / double(lineCount) * rowCount);
+}
+
+int MinimapRenderer::firstLineOfRow(int row, int lineCount, int rowCount)
+{
+    int line = qMax(0, int(double(row) * lineCount / rowCount) - 1);
+    while (line < lineCount && rowOfLine(line, lineCount, rowCount) < row) {
+        ++line;
+    }
+    return line;
+}
+
+void MinimapRenderer::clearRow(QRgb *row, int width)
+{
+    std::fill(row, row + width, Background);
+}
+
+void MinimapRenderer::drawLine(QRgb *row, int width, const QTextBlock &block, bool syntax)
+{
+    // Blank lines are known from the cached indent without reading the text
+    if (!block.isVisible() || BlockData::of(block)->indent < 0) {
+        return;
+    }
+
+    const int count = qMin(block.length() - 1, width - 2 * LeftMargin);
+    if (!syntax) {
+        for (int x = LeftMargin; x < LeftMargin + count; ++x) {
+            row[x] = blend(row[x], BarColor);
+        }
+        return;
+    }
+
+    // Colour per character from the highlighter's format runs
+    QVarLengthArray<QRgb, 256> colors(count);
+    std::fill(colors.begin(), colors.end(), PlainTextColor);
+    const QList<QTextLayout::FormatRange> formats = block.layout()->formats();
+    for (const QTextLayout::FormatRange &range : formats) {
+        const QRgb color = runColor(range);
+        if (!color || range.start >= count) {
+            continue;
+        }
+        std::fill(colors.begin() + qMax(0, range.start), colors.begin() + qMin(count, range.start + range.length), color);
+    }
+
+    // One pixel per character; whitespace stays background
+    const QString text = block.text();
+    const QChar *chars = text.constData();
+    for (int i = 0; i < count; ++i) {
+        if (!chars[i].isSpace()) {
+            row[LeftMargin + i] = blend(row[LeftMargin + i], colors[i]);
+        }
+    }
+}
+
+MinimapRenderer::Summary MinimapRenderer::summarizeLine(const QTextBlock &block, bool syntax)
+{
+    Summary summary;
+    const QString text = block.text();
+    summary.textHash = qHash(text);
+    if (!block.isVisible() || BlockData::of(block)->indent < 0) {
+        return summary;
+    }
+
+    int start = 0;
+    int end = int(text.length());
+    while (start < end && text.at(start).isSpace()) {
+        ++start;
+    }
+    while (end > start && text.at(end - 1).isSpace()) {
+        --end;
+    }
+    summary.start = quint16(qMin(start, 0xffff));
+    summary.end = quint16(qMin(end, 0xffff));
+
+    if (!syntax) {
+        summary.color = BarColor;
+        return summary;
+    }
+
+    // Columns of the extent each format colour covers; the rest is plain text
+    ColorWeights weights;
+    int formatted = 0;
+    const QList<QTextLayout::FormatRange> formats = block.layout()->formats();
+    for (const QTextLayout::FormatRange &range : formats) {
+        const QRgb color = runColor(range);
+        const int covered = qMin(end, range.start + range.length) - qMax(start, range.start);
+        if (color && covered > 0) {
+            weights.add(color, covered);
+            formatted += covered;
+        }
+    }
+    weights.add(PlainTextColor, end - start - formatted);
+    summary.color = weights.dominant();
+    return summary;
+}
+
+void MinimapRenderer::summarizeRows(const QVector<Summary> &lines, int rowCount, int firstRow, int lastRow, Summary *rows)
+{
+    const int lineCount = int(lines.size());
+    int line = firstLineOfRow(firstRow, lineCount, rowCount);
+
+    for (int y = firstRow; y <= lastRow; ++y) {
+        Summary row;
+        ColorWeights weights;
+        int start = 0xffff;
+        int end = 0;
+        for (; line < lineCount && rowOfLine(line, lineCount, rowCount) == y; ++line) {
+            const Summary &summary = lines.at(line);
+            row.markers |= summary.markers;
+            if (summary.start >= summary.end) {
+                continue;
+            }
+            start = qMin(start, int(summary.start));
+            end = qMax(end, int(summary.end));
+            weights.add(summary.color, summary.end - summary.start);
+        }
+        if (end > 0) {
+            row.start = quint16(start);
+            row.end = quint16(end);
+            row.color = weights.dominant();
+        }
+        rows[y - firstRow] = row;
+    }
+}
+
+void MinimapRenderer::drawRow(QRgb *row, int width, const Summary &summary)
+{
+    const int end = qMin(LeftMargin + int(summary.end), width - LeftMargin);
+    for (int x = LeftMargin + summary.start; x < end; ++x) {
+        row[x] = blend(row[x], summary.color);
+    }
+}
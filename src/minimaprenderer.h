@@ -0,0 +1,69 @@
+#ifndef MINIMAPRENDERER_H
+#define MINIMAPRENDERER_H
+
+#include <QRgb>
+#include <QTextBlock>
+#include <QVector>
+
+/**
+ * @brief Rasterises document lines into rows of the minimap image
+ *
+ * Pixels are written straight into the image's scanlines, one per
+ * character, so redrawing a row costs a pass over its lines and no
+ * QPainter setup. Several lines falling on one row are blended over each
+ * other.
+ *
+ * In syntax mode each character takes the foreground colour the highlighter
+ * already set in the block's layout formats, so nothing is tokenized again.
+ *
+ * Documents with more lines than the image has rows are drawn from
+ * summaries instead: each line is reduced to its extent and dominant colour,
+ * and the lines landing on a row are merged into one summary for it. Only
+ * the merge depends on the row mapping, and it reads nothing but the line
+ * summaries, so it can run on any thread.
+ */
+class MinimapRenderer
+{
+public:
+    static const QRgb Background;
+
+    // Overview markers a line or row can carry
+    enum Marker : quint8 {
+        SearchHit = 0x1,
+        Modified = 0x4
+    };
+
+    // Extent of a line or row in columns, the colour covering most of it and
+    // its markers
+    struct Summary {
+        quint16 start = 0;   // First non-space column
+        quint16 end = 0;     // Past the last non-space column; start == end when empty
+        QRgb color = 0;      // Premultiplied
+        quint8 markers = 0;  // Marker flags, set by the minimap
+        uint textHash = 0;   // Hash of the line's text; unused for rows
+    };
+
+    // Row of line when lineCount lines are spread over rowCount rows, and back
+    static int rowOfLine(int line, int lineCount, int rowCount);
+    static int firstLineOfRow(int row, int lineCount, int rowCount);
+
+    // Fill an opaque row of width pixels with the background
+    static void clearRow(QRgb *row, int width);
+
+    // Blend block onto row, as a grey bar or in syntax colours; invisible
+    // (folded) blocks draw nothing
+    static void drawLine(QRgb *row, int width, const QTextBlock &block, bool syntax);
+
+    // Summary of block, without markers; the extent is empty for blank and
+    // invisible blocks
+    static Summary summarizeLine(const QTextBlock &block, bool syntax);
+
+    // Merge lines into the summaries of rows firstRow to lastRow of rowCount,
+    // written to rows[0] onwards
+    static void summarizeRows(const QVector<Summary> &lines, int rowCount, int firstRow, int lastRow, Summary *rows);
+
+    // Draw a row summary onto a cleared row
+    static void drawRow(QRgb *row, int width, const Summary &summary);
+};
+
+#endif // MINIMAPRENDERER_H
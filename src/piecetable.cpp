@@ -0,0 +1,396 @@
+#include "piecetable.h"
+#include <cstring>
+
+namespace {
+
+qint64 countNewlines(const char *data, qint64 size)
+{
+    qint64 count = 0;
+    const char *end = data + size;
+    for (const char *p = data; p < end; ++count) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+        if (!newline) {
+            break;
+        }
+        p = newline + 1;
+    }
+    return count;
+}
+
+// Appends up to maxBytes - line.size() bytes
+void appendCapped(QByteArray &line, const char *data, qint64 size, qint64 maxBytes)
+{
+    const qint64 room = maxBytes - line.size();
+    if (room > 0) {
+        line.append(data, qMin(size, room));
+    }
+}
+
+QByteArray withoutCarriageReturn(const QByteArray &line)
+{
+    return line.endsWith('\r') ? line.left(line.size() - 1) : line;
+}
+
+} // namespace
+
+PieceTable::PieceTable()
+    : original(nullptr)
+    , length(0)
+    , newlineCount(-1)
+    , cleanIndex(0)
+{
+}
+
+PieceTable::PieceTable(const LineIndex *original)
+    : original(original)
+    , length(original->size())
+    , newlineCount(-1)
+    , cleanIndex(0)
+{
+    if (length > 0) {
+        pieces.append({false, 0, length, -1});
+    }
+}
+
+qint64 PieceTable::lineCount() const
+{
+    if (isPristine()) {
+        return original ? original->lineCount() : 1;
+    }
+    return newlineCount + 1;
+}
+
+const char *PieceTable::pieceData(const Piece &piece) const
+{
+    return (piece.added ? added.constData() : original->data()) + piece.start;
+}
+
+qint64 PieceTable::newlinesIn(const Piece &piece, qint64 from, qint64 to) const
+{
+    if (piece.added) {
+        return countNewlines(pieceData(piece) + from, to - from);
+    }
+    return original->lineAt(piece.start + to) - original->lineAt(piece.start + from);
+}
+
+PieceTable::Piece PieceTable::slice(const Piece &piece, qint64 from, qint64 to) const
+{
+    return {piece.added, piece.start + from, to - from, newlinesIn(piece, from, to)};
+}
+
+qint64 PieceTable::lineStart(qint64 line) const
+{
+    if (isPristine()) {
+        return original && line < original->lineCount() ? original->lineStart(line) : length;
+    }
+    if (line <= 0) {
+        return 0;
+    }
+
+    qint64 newlines = 0;
+    qint64 position = 0;
+    for (const Piece &piece : pieces) {
+        if (newlines + piece.newlines >= line) {
+            // The line starts after the nth newline of this piece
+            const qint64 nth = line - newlines;
+            if (piece.added) {
+                const char *bytes = pieceData(piece);
+                const char *p = bytes;
+                for (qint64 i = 0; i < nth; ++i) {
+                    p = static_cast<const char *>(std::memchr(p, '\n', size_t(bytes + piece.length - p))) + 1;
+                }
+                return position + (p - bytes);
+            }
+            const qint64 firstLine = original->lineAt(piece.start);
+            return position + original->lineStart(firstLine + nth) - piece.start;
+        }
+        newlines += piece.newlines;
+        position += piece.length;
+    }
+    return length;
+}
+
+qint64 PieceTable::lineAt(qint64 offset) const
+{
+    if (isPristine()) {
+        return original ? original->lineAt(qMin(offset, original->indexedBytes())) : 0;
+    }
+
+    qint64 newlines = 0;
+    qint64 position = 0;
+    for (const Piece &piece : pieces) {
+        if (offset < position + piece.length) {
+            return newlines + newlinesIn(piece, 0, offset - position);
+        }
+        newlines += piece.newlines;
+        position += piece.length;
+    }
+    return newlines;
+}
+
+QByteArray PieceTable::read(qint64 offset, qint64 maxLength) const
+{
+    QByteArray bytes;
+    qint64 position = 0;
+    for (const Piece &piece : pieces) {
+        if (bytes.size() >= maxLength) {
+            break;
+        }
+        const qint64 end = position + piece.length;
+        if (offset < end) {
+            const qint64 from = qMax<qint64>(0, offset - position);
+            appendCapped(bytes, pieceData(piece) + from, piece.length - from, maxLength);
+        }
+        position = end;
+    }
+    return bytes;
+}
+
+QByteArray PieceTable::lineBytes(qint64 lineStart, qint64 maxBytes) const
+{
+    QByteArray line;
+    qint64 position = 0;
+    for (const Piece &piece : pieces) {
+        const qint64 end = position + piece.length;
+        if (lineStart < end) {
+            const qint64 from = qMax<qint64>(0, lineStart - position);
+            const char *bytes = pieceData(piece);
+            const void *newline = std::memchr(bytes + from, '\n', size_t(piece.length - from));
+            const qint64 to = newline ? static_cast<const char *>(newline) - bytes : piece.length;
+            appendCapped(line, bytes + from, to - from, maxBytes);
+            if (newline || line.size() >= maxBytes) {
+                break;
+            }
+        }
+        position = end;
+    }
+    return withoutCarriageReturn(line);
+}
+
+void PieceTable::forEachLine(qint64 from, qint64 to, qint64 maxBytes, const LineVisitor &visit) const
+{
+    if (from >= to) {
+        return;
+    }
+
+    int index = 0;
+    qint64 position = 0;
+    while (index < pieces.size() && position + pieces.at(index).length <= from) {
+        position += pieces.at(index).length;
+        ++index;
+    }
+
+    // A line spanning pieces is gathered in carry; any other is not copied
+    QByteArray carry;
+    bool carrying = false;
+    qint64 lineStart = from;
+    for (qint64 at = from - position; index < pieces.size(); ++index, at = 0) {
+        const Piece &piece = pieces.at(index);
+        const char *bytes = pieceData(piece);
+        while (at < piece.length) {
+            const void *found = std::memchr(bytes + at, '\n', size_t(piece.length - at));
+            if (!found) {
+                appendCapped(carry, bytes + at, piece.length - at, maxBytes);
+                carrying = true;
+                break;
+            }
+            const qint64 newline = static_cast<const char *>(found) - bytes;
+            QByteArray line;
+            if (carrying) {
+                appendCapped(carry, bytes + at, newline - at, maxBytes);
+                line = carry;
+                carry.clear();
+                carrying = false;
+            } else {
+                line = QByteArray::fromRawData(bytes + at, qMin(newline - at, maxBytes));
+            }
+            if (visit(lineStart, withoutCarriageReturn(line))) {
+                return;
+            }
+            lineStart = position + newline + 1;
+            if (lineStart >= to) {
+                return;
+            }
+            at = newline + 1;
+        }
+        position += piece.length;
+    }
+
+    // The last line has no line break
+    visit(lineStart, withoutCarriageReturn(carry));
+}
+
+qint64 PieceTable::startOfLine(qint64 offset) const
+{
+    if (offset <= 0) {
+        return 0;
+    }
+
+    // Back from the byte before offset to the newline ending the line before
+    int index = 0;
+    qint64 position = 0;
+    while (index < pieces.size() && position + pieces.at(index).length < offset) {
+        position += pieces.at(index).length;
+        ++index;
+    }
+    if (index == pieces.size()) {
+        return 0;
+    }
+
+    for (qint64 at = offset - position; index >= 0; --index) {
+        const char *bytes = pieceData(pieces.at(index));
+        while (--at >= 0) {
+            if (bytes[at] == '\n') {
+                return position + at + 1;
+            }
+        }
+        if (index > 0) {
+            position -= pieces.at(index - 1).length;
+            at = pieces.at(index - 1).length;
+        }
+    }
+    return 0;
+}
+
+void PieceTable::forEachLineBackward(qint64 from, qint64 to, qint64 maxBytes, const LineVisitor &visit) const
+{
+    // Each step back looks up its piece again; edits leave few pieces
+    for (qint64 start = from; ; start = startOfLine(start - 1)) {
+        if (visit(start, lineBytes(start, maxBytes)) || start <= to || start == 0) {
+            return;
+        }
+    }
+}
+
+void PieceTable::swapPieces(int first, int count, const QVector<Piece> &with)
+{
+    for (int i = first; i < first + count; ++i) {
+        length -= pieces.at(i).length;
+        newlineCount -= pieces.at(i).newlines;
+    }
+    pieces.remove(first, count);
+    for (int i = 0; i < with.size(); ++i) {
+        pieces.insert(first + i, with.at(i));
+        length += with.at(i).length;
+        newlineCount += with.at(i).newlines;
+    }
+}
+
+void PieceTable::pushChange(const Change &change)
+{
+    redoStack.clear();
+    if (cleanIndex > undoStack.size()) {
+        cleanIndex = -1;  // The saved state was undone and is now gone
+    }
+    undoStack.append(change);
+}
+
+void PieceTable::replace(qint64 offset, qint64 removeLength, const QByteArray &bytes)
+{
+    if (!isEditable() || offset < 0 || offset > length) {
+        return;
+    }
+    removeLength = qMin(removeLength, length - offset);
+    if (removeLength <= 0 && bytes.isEmpty()) {
+        return;
+    }
+
+    // The first edit needs the line count of the original
+    if (isPristine()) {
+        newlineCount = original->lineCount() - 1;
+        if (!pieces.isEmpty()) {
+            pieces[0].newlines = newlineCount;
+        }
+    }
+
+    // Pieces [first, last) span position to end, which covers the replaced range
+    int first = 0;
+    qint64 position = 0;
+    while (first < pieces.size() && position + pieces.at(first).length <= offset) {
+        position += pieces.at(first).length;
+        ++first;
+    }
+    int last = first;
+    qint64 end = position;
+    while (last < pieces.size() && end < offset + removeLength) {
+        end += pieces.at(last).length;
+        ++last;
+    }
+
+    // Typing: extend the insertion just before rather than adding a piece
+    if (removeLength <= 0 && position == offset && first > 0) {
+        Piece &previous = pieces[first - 1];
+        if (previous.added && previous.start + previous.length == added.size()) {
+            const Piece before = previous;
+            const qint64 newlines = countNewlines(bytes.constData(), bytes.size());
+            added.append(bytes);
+            previous.length += bytes.size();
+            previous.newlines += newlines;
+            length += bytes.size();
+            newlineCount += newlines;
+
+            // Still the same undo step if the previous step made that piece
+            // and the document was not saved since
+            Change *top = canUndo() && redoStack.isEmpty() ? &undoStack.last() : nullptr;
+            if (top && cleanIndex != undoStack.size() && !top->inserted.isEmpty() &&
+                top->first + top->inserted.size() == first && top->inserted.last() == before) {
+                top->inserted.last() = previous;
+                top->insertedBytes += bytes.size();
+            } else {
+                pushChange({first - 1, {before}, {previous}, offset, 0, bytes.size()});
+            }
+            return;
+        }
+    }
+
+    QVector<Piece> inserted;
+    if (first < last && position < offset) {
+        inserted.append(slice(pieces.at(first), 0, offset - position));
+    }
+    if (!bytes.isEmpty()) {
+        inserted.append({true, added.size(), bytes.size(), countNewlines(bytes.constData(), bytes.size())});
+        added.append(bytes);
+    }
+    const qint64 removeEnd = offset + removeLength;
+    if (first < last && end > removeEnd) {
+        const Piece &tail = pieces.at(last - 1);
+        const qint64 tailStart = end - tail.length;
+        inserted.append(slice(tail, removeEnd - tailStart, tail.length));
+    }
+
+    const Change change{first, pieces.mid(first, last - first), inserted, offset, removeLength, bytes.size()};
+    swapPieces(first, last - first, inserted);
+    pushChange(change);
+}
+
+qint64 PieceTable::undo()
+{
+    if (!canUndo()) {
+        return 0;
+    }
+    const Change change = undoStack.takeLast();
+    swapPieces(change.first, int(change.inserted.size()), change.removed);
+    redoStack.append(change);
+    return change.offset + change.removedBytes;
+}
+
+qint64 PieceTable::redo()
+{
+    if (!canRedo()) {
+        return 0;
+    }
+    const Change change = redoStack.takeLast();
+    swapPieces(change.first, int(change.removed.size()), change.inserted);
+    undoStack.append(change);
+    return change.offset + change.insertedBytes;
+}
+
+bool PieceTable::write(QIODevice *device) const
+{
+    for (const Piece &piece : pieces) {
+        if (device->write(pieceData(piece), piece.length) != piece.length) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,124 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QVector>
+#include <functional>
+#include "lineindex.h"
+
+/**
+ * @brief Editable bytes over a read-only original buffer
+ *
+ * The text is a list of pieces, each a span of either the original buffer
+ * (a memory-mapped file) or an append-only buffer holding every inserted
+ * byte. An edit splits at most two pieces and adds one, so memory grows
+ * with the edits made, never with the size of the file. Undo and redo swap
+ * piece spans back in; the buffers themselves never change.
+ *
+ * Line lookups go through the original's LineIndex for original pieces and
+ * walk the piece list, which stays short for the edits a person makes.
+ * Copies share everything until one of them is edited, so a copy is a cheap
+ * snapshot for a worker thread.
+ */
+class PieceTable
+{
+public:
+    // Called with the start of each line and its bytes, without the line
+    // break; returning true stops the walk
+    using LineVisitor = std::function<bool(qint64 lineStart, const QByteArray &bytes)>;
+
+    PieceTable();
+
+    // original is the indexed buffer; it must outlive the table and its
+    // copies. The table can be read while the index is still being built,
+    // and edited once it is complete.
+    explicit PieceTable(const LineIndex *original);
+
+    qint64 size() const { return length; }
+    qint64 lineCount() const;
+    bool isEditable() const { return original && original->isComplete(); }
+
+    // Offset of the first byte of line, or size() past the last line
+    qint64 lineStart(qint64 line) const;
+
+    // Line holding the byte at offset (at most size())
+    qint64 lineAt(qint64 offset) const;
+
+    // Start of the line holding offset, found from the bytes alone
+    qint64 startOfLine(qint64 offset) const;
+
+    // Up to maxLength bytes from offset
+    QByteArray read(qint64 offset, qint64 maxLength) const;
+
+    // The line starting at lineStart without its line break ("\n" or
+    // "\r\n"), cut after maxBytes
+    QByteArray lineBytes(qint64 lineStart, qint64 maxBytes) const;
+
+    // Lines starting in [from, to), first to last, or starting in [to, from]
+    // from last to first. from must be the start of a line; bytes are cut
+    // after maxBytes. Like startOfLine(), these read only the bytes, never
+    // the line index, so they are safe on a copy while the index grows.
+    void forEachLine(qint64 from, qint64 to, qint64 maxBytes, const LineVisitor &visit) const;
+    void forEachLineBackward(qint64 from, qint64 to, qint64 maxBytes, const LineVisitor &visit) const;
+
+    // Replace length bytes at offset with bytes as one undo step. Inserting
+    // right after the previous insertion extends it instead.
+    void replace(qint64 offset, qint64 length, const QByteArray &bytes);
+
+    bool canUndo() const { return !undoStack.isEmpty(); }
+    bool canRedo() const { return !redoStack.isEmpty(); }
+
+    // Undo or redo one step; returns the offset after the bytes it put back
+    qint64 undo();
+    qint64 redo();
+
+    bool isModified() const { return undoStack.size() != cleanIndex; }
+    void setClean() { cleanIndex = int(undoStack.size()); }
+
+    // Write every byte to device
+    bool write(QIODevice *device) const;
+
+private:
+    struct Piece {
+        bool added;        // In the append buffer, else in the original
+        qint64 start;
+        qint64 length;
+        qint64 newlines;   // -1 for the untouched original until it is indexed
+
+        bool operator==(const Piece &other) const
+        {
+            return added == other.added && start == other.start && length == other.length;
+        }
+    };
+
+    // One edit: the pieces from first on that replaced removed, and the
+    // bytes it replaced at offset
+    struct Change {
+        int first;
+        QVector<Piece> removed;
+        QVector<Piece> inserted;
+        qint64 offset;
+        qint64 removedBytes;
+        qint64 insertedBytes;
+    };
+
+    const LineIndex *original;
+    QByteArray added;
+    QVector<Piece> pieces;
+    qint64 length;
+    qint64 newlineCount;  // -1 while the table is pristine
+
+    QVector<Change> undoStack;
+    QVector<Change> redoStack;
+    int cleanIndex;  // Undo depth of the saved state, -1 once it cannot be reached
+
+    bool isPristine() const { return newlineCount < 0; }
+    const char *pieceData(const Piece &piece) const;
+    Piece slice(const Piece &piece, qint64 from, qint64 to) const;
+    qint64 newlinesIn(const Piece &piece, qint64 from, qint64 to) const;
+    void swapPieces(int first, int count, const QVector<Piece> &with);
+    void pushChange(const Change &change);
+};
+
+#endif // PIECETABLE_H
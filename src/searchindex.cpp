@@ -0,0 +1,104 @@
+#include "searchindex.h"
+
+namespace {
+
+// Lines scanned between checks for cancellation
+const int CancelCheckLines = 4096;
+
+bool isWordCharacter(QChar c)
+{
+    return c.isLetterOrNumber() || c == '_';
+}
+
+} // namespace
+
+bool SearchIndex::Query::operator==(const Query &other) const
+{
+    return text == other.text && caseSensitive == other.caseSensitive &&
+           wholeWords == other.wholeWords && useRegex == other.useRegex;
+}
+
+SearchIndex::SearchIndex(const Query &query)
+    : currentQuery(query)
+{
+    const Qt::CaseSensitivity sensitivity = query.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (query.useRegex) {
+        // Whole words the way QTextDocument::FindWholeWords treats a regex
+        const QString pattern = query.wholeWords ? "\\b(?:" + query.text + ")\\b" : query.text;
+        regex.setPattern(pattern);
+        regex.setPatternOptions(query.caseSensitive ? QRegularExpression::NoPatternOption
+                                                    : QRegularExpression::CaseInsensitiveOption);
+        regex.optimize();
+    } else {
+        matcher = QStringMatcher(query.text, sensitivity);
+    }
+}
+
+int SearchIndex::indexIn(const QString &line, int from, int *length) const
+{
+    if (currentQuery.isEmpty()) {
+        return -1;
+    }
+
+    if (currentQuery.useRegex) {
+        if (!regex.isValid()) {
+            return -1;
+        }
+        const QRegularExpressionMatch match = regex.match(line, from);
+        if (!match.hasMatch()) {
+            return -1;
+        }
+        if (length) {
+            *length = int(match.capturedLength());
+        }
+        return int(match.capturedStart());
+    }
+
+    const qsizetype textLength = currentQuery.text.length();
+    for (qsizetype at = matcher.indexIn(line, from); at >= 0; at = matcher.indexIn(line, at + 1)) {
+        if (currentQuery.wholeWords) {
+            const bool startsWord = at == 0 || !isWordCharacter(line.at(at - 1));
+            const bool endsWord = at + textLength == line.length() || !isWordCharacter(line.at(at + textLength));
+            if (!startsWord || !endsWord) {
+                continue;
+            }
+        }
+        if (length) {
+            *length = int(textLength);
+        }
+        return int(at);
+    }
+    return -1;
+}
+
+QVector<int> SearchIndex::matchingLines(const QString &snapshot, const std::function<bool()> &cancelled) const
+{
+    QVector<int> lines;
+    if (currentQuery.isEmpty()) {
+        return lines;
+    }
+
+    const QChar separator = QChar::ParagraphSeparator;
+    qsizetype pos = 0;
+    for (int number = 0; ; ++number) {
+        if (number % CancelCheckLines == 0 && cancelled()) {
+            return lines;
+        }
+
+        qsizetype end = snapshot.indexOf(separator, pos);
+        const bool last = end < 0;
+        if (last) {
+            end = snapshot.size();
+        }
+
+        // A view into the snapshot; nothing is copied per line
+        if (matches(QString::fromRawData(snapshot.constData() + pos, end - pos))) {
+            lines.append(number);
+        }
+
+        if (last) {
+            return lines;
+        }
+        pos = end + 1;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QRegularExpression>
+#include <QString>
+#include <QStringMatcher>
+#include <QVector>
+#include <functional>
+
+/**
+ * @brief Finds the lines of a text that match a find query
+ *
+ * The minimap scans the whole document once per query, on a worker thread
+ * from a snapshot of the text, and afterwards checks only the lines that
+ * change. The large file view finds matches with it one line at a time.
+ * The pattern is compiled once per index, so every line costs a single
+ * match.
+ */
+class SearchIndex
+{
+public:
+    struct Query {
+        QString text;
+        bool caseSensitive = false;
+        bool wholeWords = false;
+        bool useRegex = false;
+
+        bool isEmpty() const { return text.isEmpty(); }
+        bool operator==(const Query &other) const;
+        bool operator!=(const Query &other) const { return !(*this == other); }
+    };
+
+    explicit SearchIndex(const Query &query = Query());
+
+    const Query &query() const { return currentQuery; }
+
+    // Whether line contains a match; always false for an empty query
+    bool matches(const QString &line) const { return indexIn(line, 0) >= 0; }
+
+    // Column of the first match in line starting at or after from, or -1;
+    // length (may be null) receives the length of the match
+    int indexIn(const QString &line, int from, int *length = nullptr) const;
+
+    // Numbers of the matching lines of snapshot, whose lines are separated by
+    // U+2029 as in QTextDocument::toRawText(). Returns early, with the lines
+    // found so far, once cancelled() is true.
+    QVector<int> matchingLines(const QString &snapshot, const std::function<bool()> &cancelled) const;
+
+private:
+    Query currentQuery;
+    QStringMatcher matcher;
+    QRegularExpression regex;
+};
+
+#endif // SEARCHINDEX_H
@@ -0,0 +1,552 @@
+#include "simdscan.h"
+#include <QByteArray>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define SIMDSCAN_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define SIMDSCAN_AVX2 1
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__)
+#define SIMDSCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+struct Kernels {
+    const char *name;
+    qint64 (*asciiPrefix)(const unsigned char *data, qint64 size);
+    qint64 (*checkUtf8)(const unsigned char *data, qint64 begin, qint64 end, bool *ascii);
+    void (*swapBytes16)(const char *src, char *dst, qint64 units);
+    void (*swapBytes32)(const char *src, char *dst, qint64 units);
+    qint64 (*widenUtf16)(const char16_t *src, char *dst, qint64 units);
+    qint64 (*narrowUtf32)(const char *src, char16_t *dst, qint64 units);
+};
+
+inline bool isSurrogate(char32_t c)
+{
+    return (c & 0xFFFFF800) == 0xD800;
+}
+
+// Eight bytes at a time through a 64-bit word
+qint64 asciiPrefixScalar(const unsigned char *data, qint64 size)
+{
+    qint64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            break;
+        }
+    }
+    while (i < size && data[i] <= 0x7F) {
+        ++i;
+    }
+    return i;
+}
+
+// The callers' byte loop does all the work
+qint64 checkUtf8Scalar(const unsigned char *, qint64 begin, qint64, bool *)
+{
+    return begin;
+}
+
+// Both bytes are read before either is written, so dst may be src
+void swapBytes16Scalar(const char *src, char *dst, qint64 units)
+{
+    for (qint64 i = 0; i < units * 2; i += 2) {
+        const char low = src[i];
+        const char high = src[i + 1];
+        dst[i] = high;
+        dst[i + 1] = low;
+    }
+}
+
+void swapBytes32Scalar(const char *src, char *dst, qint64 units)
+{
+    for (qint64 i = 0; i < units * 4; i += 4) {
+        char unit[4];
+        std::memcpy(unit, src + i, 4);
+        for (int b = 0; b < 4; ++b) {
+            dst[i + b] = unit[3 - b];
+        }
+    }
+}
+
+qint64 widenUtf16Scalar(const char16_t *src, char *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i < units && !isSurrogate(src[i]); ++i) {
+        const char32_t c = src[i];
+        std::memcpy(dst + i * 4, &c, 4);
+    }
+    return i;
+}
+
+qint64 narrowUtf32Scalar(const char *src, char16_t *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i < units; ++i) {
+        char32_t c;
+        std::memcpy(&c, src + i * 4, 4);
+        if (c > 0xFFFF || isSurrogate(c)) {
+            break;
+        }
+        dst[i] = char16_t(c);
+    }
+    return i;
+}
+
+#ifdef SIMDSCAN_SSE2
+
+// Unsigned a >= b per byte; SSE2 only compares signed bytes
+inline __m128i atLeast(__m128i a, __m128i b)
+{
+    return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+}
+
+inline __m128i load(const void *p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+inline void store(void *p, __m128i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+}
+
+inline __m128i swap16(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+// Lanes of 16-bit units that are surrogates
+inline __m128i surrogates(__m128i v)
+{
+    return _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(short(0xF800))), _mm_set1_epi16(short(0xD800)));
+}
+
+qint64 asciiPrefixSse2(const unsigned char *data, qint64 size)
+{
+    qint64 i = 0;
+    for (; i + 16 <= size; i += 16) {
+        if (_mm_movemask_epi8(load(data + i))) {
+            break;
+        }
+    }
+    return i + asciiPrefixScalar(data + i, size - i);
+}
+
+// A byte must be a continuation byte exactly when one of the three before
+// it is a lead byte announcing that many; bytes from F8 on never occur
+qint64 checkUtf8Sse2(const unsigned char *data, qint64 begin, qint64 end, bool *ascii)
+{
+    const __m128i continuationMask = _mm_set1_epi8(char(0xC0));
+    const __m128i continuation = _mm_set1_epi8(char(0x80));
+    const __m128i lead2 = _mm_set1_epi8(char(0xC0));
+    const __m128i lead3 = _mm_set1_epi8(char(0xE0));
+    const __m128i lead4 = _mm_set1_epi8(char(0xF0));
+    const __m128i invalid = _mm_set1_epi8(char(0xF8));
+
+    __m128i seen = _mm_setzero_si128();
+    qint64 i = begin;
+    for (; i + 16 <= end; i += 16) {
+        const __m128i bytes = load(data + i);
+        const __m128i back3 = load(data + i - 3);
+
+        // ASCII here and in the three bytes before
+        if (!_mm_movemask_epi8(_mm_or_si128(bytes, back3))) {
+            continue;
+        }
+        seen = _mm_or_si128(seen, bytes);
+
+        const __m128i isContinuation = _mm_cmpeq_epi8(_mm_and_si128(bytes, continuationMask), continuation);
+        const __m128i expected = _mm_or_si128(_mm_or_si128(atLeast(load(data + i - 1), lead2),
+                                                           atLeast(load(data + i - 2), lead3)),
+                                              atLeast(back3, lead4));
+        const __m128i error = _mm_or_si128(_mm_xor_si128(isContinuation, expected), atLeast(bytes, invalid));
+        if (_mm_movemask_epi8(error)) {
+            return -1;
+        }
+    }
+    if (_mm_movemask_epi8(seen)) {
+        *ascii = false;
+    }
+    return i;
+}
+
+void swapBytes16Sse2(const char *src, char *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i + 8 <= units; i += 8) {
+        store(dst + i * 2, swap16(load(src + i * 2)));
+    }
+    swapBytes16Scalar(src + i * 2, dst + i * 2, units - i);
+}
+
+// Swap the 16-bit halves of each unit, then the bytes of each half
+void swapBytes32Sse2(const char *src, char *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i + 4 <= units; i += 4) {
+        const __m128i halves = _mm_shufflehi_epi16(_mm_shufflelo_epi16(load(src + i * 4), _MM_SHUFFLE(2, 3, 0, 1)),
+                                                   _MM_SHUFFLE(2, 3, 0, 1));
+        store(dst + i * 4, swap16(halves));
+    }
+    swapBytes32Scalar(src + i * 4, dst + i * 4, units - i);
+}
+
+qint64 widenUtf16Sse2(const char16_t *src, char *dst, qint64 units)
+{
+    const __m128i zero = _mm_setzero_si128();
+    qint64 i = 0;
+    for (; i + 8 <= units; i += 8) {
+        const __m128i v = load(src + i);
+        if (_mm_movemask_epi8(surrogates(v))) {
+            break;
+        }
+        store(dst + i * 4, _mm_unpacklo_epi16(v, zero));
+        store(dst + i * 4 + 16, _mm_unpackhi_epi16(v, zero));
+    }
+    return i + widenUtf16Scalar(src + i, dst + i * 4, units - i);
+}
+
+qint64 narrowUtf32Sse2(const char *src, char16_t *dst, qint64 units)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(short(0x8000));
+    qint64 i = 0;
+    for (; i + 8 <= units; i += 8) {
+        const __m128i a = load(src + i * 4);
+        const __m128i b = load(src + i * 4 + 16);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(_mm_or_si128(a, b), 16), zero)) != 0xFFFF) {
+            break; // Beyond the BMP
+        }
+
+        // SSE2 only packs with signed saturation, so the units are moved
+        // into its range and back
+        const __m128i narrow = _mm_add_epi16(_mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32)), bias16);
+        if (_mm_movemask_epi8(surrogates(narrow))) {
+            break;
+        }
+        store(dst + i, narrow);
+    }
+    return i + narrowUtf32Scalar(src + i * 4, dst + i, units - i);
+}
+
+#endif // SIMDSCAN_SSE2
+
+#ifdef SIMDSCAN_AVX2
+
+__attribute__((target("avx2")))
+inline __m256i atLeast256(__m256i a, __m256i b)
+{
+    return _mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a);
+}
+
+__attribute__((target("avx2")))
+inline __m256i load256(const void *p)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+__attribute__((target("avx2")))
+inline void store256(void *p, __m256i v)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+}
+
+__attribute__((target("avx2")))
+inline __m256i surrogates256(__m256i v)
+{
+    return _mm256_cmpeq_epi16(_mm256_and_si256(v, _mm256_set1_epi16(short(0xF800))), _mm256_set1_epi16(short(0xD800)));
+}
+
+__attribute__((target("avx2")))
+qint64 asciiPrefixAvx2(const unsigned char *data, qint64 size)
+{
+    qint64 i = 0;
+    for (; i + 32 <= size; i += 32) {
+        if (_mm256_movemask_epi8(load256(data + i))) {
+            break;
+        }
+    }
+    return i + asciiPrefixScalar(data + i, size - i);
+}
+
+// The SSE2 kernel on 32 bytes at a time
+__attribute__((target("avx2")))
+qint64 checkUtf8Avx2(const unsigned char *data, qint64 begin, qint64 end, bool *ascii)
+{
+    const __m256i continuationMask = _mm256_set1_epi8(char(0xC0));
+    const __m256i continuation = _mm256_set1_epi8(char(0x80));
+    const __m256i lead2 = _mm256_set1_epi8(char(0xC0));
+    const __m256i lead3 = _mm256_set1_epi8(char(0xE0));
+    const __m256i lead4 = _mm256_set1_epi8(char(0xF0));
+    const __m256i invalid = _mm256_set1_epi8(char(0xF8));
+
+    __m256i seen = _mm256_setzero_si256();
+    qint64 i = begin;
+    for (; i + 32 <= end; i += 32) {
+        const __m256i bytes = load256(data + i);
+        const __m256i back3 = load256(data + i - 3);
+        if (!_mm256_movemask_epi8(_mm256_or_si256(bytes, back3))) {
+            continue;
+        }
+        seen = _mm256_or_si256(seen, bytes);
+
+        const __m256i isContinuation = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, continuationMask), continuation);
+        const __m256i expected = _mm256_or_si256(_mm256_or_si256(atLeast256(load256(data + i - 1), lead2),
+                                                                 atLeast256(load256(data + i - 2), lead3)),
+                                                 atLeast256(back3, lead4));
+        const __m256i error = _mm256_or_si256(_mm256_xor_si256(isContinuation, expected), atLeast256(bytes, invalid));
+        if (_mm256_movemask_epi8(error)) {
+            return -1;
+        }
+    }
+    if (_mm256_movemask_epi8(seen)) {
+        *ascii = false;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+void swapBytes16Avx2(const char *src, char *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i + 16 <= units; i += 16) {
+        const __m256i v = load256(src + i * 2);
+        store256(dst + i * 2, _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8)));
+    }
+    swapBytes16Scalar(src + i * 2, dst + i * 2, units - i);
+}
+
+__attribute__((target("avx2")))
+void swapBytes32Avx2(const char *src, char *dst, qint64 units)
+{
+    const __m256i reverse = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                             3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    qint64 i = 0;
+    for (; i + 8 <= units; i += 8) {
+        store256(dst + i * 4, _mm256_shuffle_epi8(load256(src + i * 4), reverse));
+    }
+    swapBytes32Scalar(src + i * 4, dst + i * 4, units - i);
+}
+
+__attribute__((target("avx2")))
+qint64 widenUtf16Avx2(const char16_t *src, char *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i + 16 <= units; i += 16) {
+        const __m256i v = load256(src + i);
+        if (_mm256_movemask_epi8(surrogates256(v))) {
+            break;
+        }
+        store256(dst + i * 4, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+        store256(dst + i * 4 + 32, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)));
+    }
+    return i + widenUtf16Scalar(src + i, dst + i * 4, units - i);
+}
+
+__attribute__((target("avx2")))
+qint64 narrowUtf32Avx2(const char *src, char16_t *dst, qint64 units)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    qint64 i = 0;
+    for (; i + 16 <= units; i += 16) {
+        const __m256i a = load256(src + i * 4);
+        const __m256i b = load256(src + i * 4 + 32);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_srli_epi32(_mm256_or_si256(a, b), 16), zero)) != -1) {
+            break; // Beyond the BMP
+        }
+
+        // The pack works per 128-bit lane; the permute puts the units back
+        // in order
+        const __m256i narrow = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        if (_mm256_movemask_epi8(surrogates256(narrow))) {
+            break;
+        }
+        store256(dst + i, narrow);
+    }
+    return i + narrowUtf32Scalar(src + i * 4, dst + i, units - i);
+}
+
+#endif // SIMDSCAN_AVX2
+
+#ifdef SIMDSCAN_NEON
+
+qint64 asciiPrefixNeon(const unsigned char *data, qint64 size)
+{
+    qint64 i = 0;
+    for (; i + 16 <= size; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(data + i)) > 0x7F) {
+            break;
+        }
+    }
+    return i + asciiPrefixScalar(data + i, size - i);
+}
+
+// The SSE2 kernel; NEON compares unsigned bytes directly
+qint64 checkUtf8Neon(const unsigned char *data, qint64 begin, qint64 end, bool *ascii)
+{
+    const uint8x16_t continuationMask = vdupq_n_u8(0xC0);
+    const uint8x16_t continuation = vdupq_n_u8(0x80);
+    const uint8x16_t lead2 = vdupq_n_u8(0xC0);
+    const uint8x16_t lead3 = vdupq_n_u8(0xE0);
+    const uint8x16_t lead4 = vdupq_n_u8(0xF0);
+    const uint8x16_t invalid = vdupq_n_u8(0xF8);
+
+    uint8x16_t seen = vdupq_n_u8(0);
+    qint64 i = begin;
+    for (; i + 16 <= end; i += 16) {
+        const uint8x16_t bytes = vld1q_u8(data + i);
+        const uint8x16_t back3 = vld1q_u8(data + i - 3);
+        if (vmaxvq_u8(vorrq_u8(bytes, back3)) <= 0x7F) {
+            continue;
+        }
+        seen = vorrq_u8(seen, bytes);
+
+        const uint8x16_t isContinuation = vceqq_u8(vandq_u8(bytes, continuationMask), continuation);
+        const uint8x16_t expected = vorrq_u8(vorrq_u8(vcgeq_u8(vld1q_u8(data + i - 1), lead2),
+                                                      vcgeq_u8(vld1q_u8(data + i - 2), lead3)),
+                                             vcgeq_u8(back3, lead4));
+        const uint8x16_t error = vorrq_u8(veorq_u8(isContinuation, expected), vcgeq_u8(bytes, invalid));
+        if (vmaxvq_u8(error)) {
+            return -1;
+        }
+    }
+    if (vmaxvq_u8(seen) > 0x7F) {
+        *ascii = false;
+    }
+    return i;
+}
+
+void swapBytes16Neon(const char *src, char *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i + 8 <= units; i += 8) {
+        vst1q_u8(reinterpret_cast<uint8_t *>(dst + i * 2), vrev16q_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(src + i * 2))));
+    }
+    swapBytes16Scalar(src + i * 2, dst + i * 2, units - i);
+}
+
+void swapBytes32Neon(const char *src, char *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i + 4 <= units; i += 4) {
+        vst1q_u8(reinterpret_cast<uint8_t *>(dst + i * 4), vrev32q_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(src + i * 4))));
+    }
+    swapBytes32Scalar(src + i * 4, dst + i * 4, units - i);
+}
+
+inline bool anySurrogate(uint16x8_t v)
+{
+    return vmaxvq_u16(vceqq_u16(vandq_u16(v, vdupq_n_u16(0xF800)), vdupq_n_u16(0xD800))) != 0;
+}
+
+qint64 widenUtf16Neon(const char16_t *src, char *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i + 8 <= units; i += 8) {
+        const uint16x8_t v = vld1q_u16(reinterpret_cast<const uint16_t *>(src + i));
+        if (anySurrogate(v)) {
+            break;
+        }
+        vst1q_u8(reinterpret_cast<uint8_t *>(dst + i * 4), vreinterpretq_u8_u32(vmovl_u16(vget_low_u16(v))));
+        vst1q_u8(reinterpret_cast<uint8_t *>(dst + i * 4 + 16), vreinterpretq_u8_u32(vmovl_high_u16(v)));
+    }
+    return i + widenUtf16Scalar(src + i, dst + i * 4, units - i);
+}
+
+qint64 narrowUtf32Neon(const char *src, char16_t *dst, qint64 units)
+{
+    qint64 i = 0;
+    for (; i + 8 <= units; i += 8) {
+        const uint32x4_t a = vreinterpretq_u32_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(src + i * 4)));
+        const uint32x4_t b = vreinterpretq_u32_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(src + i * 4 + 16)));
+        if (vmaxvq_u32(vorrq_u32(a, b)) > 0xFFFF) {
+            break; // Beyond the BMP
+        }
+        const uint16x8_t narrow = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+        if (anySurrogate(narrow)) {
+            break;
+        }
+        vst1q_u16(reinterpret_cast<uint16_t *>(dst + i), narrow);
+    }
+    return i + narrowUtf32Scalar(src + i * 4, dst + i, units - i);
+}
+
+#endif // SIMDSCAN_NEON
+
+Kernels pickKernels()
+{
+    const QByteArray cap = qgetenv("EDDY_SIMD");
+    if (cap == "scalar") {
+        return {"scalar", asciiPrefixScalar, checkUtf8Scalar,
+                swapBytes16Scalar, swapBytes32Scalar, widenUtf16Scalar, narrowUtf32Scalar};
+    }
+#ifdef SIMDSCAN_AVX2
+    __builtin_cpu_init();
+    if (cap != "sse2" && __builtin_cpu_supports("avx2")) {
+        return {"avx2", asciiPrefixAvx2, checkUtf8Avx2,
+                swapBytes16Avx2, swapBytes32Avx2, widenUtf16Avx2, narrowUtf32Avx2};
+    }
+#endif
+#if defined(SIMDSCAN_SSE2)
+    return {"sse2", asciiPrefixSse2, checkUtf8Sse2,
+            swapBytes16Sse2, swapBytes32Sse2, widenUtf16Sse2, narrowUtf32Sse2};
+#elif defined(SIMDSCAN_NEON)
+    return {"neon", asciiPrefixNeon, checkUtf8Neon,
+            swapBytes16Neon, swapBytes32Neon, widenUtf16Neon, narrowUtf32Neon};
+#else
+    return {"scalar", asciiPrefixScalar, checkUtf8Scalar,
+            swapBytes16Scalar, swapBytes32Scalar, widenUtf16Scalar, narrowUtf32Scalar};
+#endif
+}
+
+const Kernels &kernels()
+{
+    static const Kernels picked = pickKernels();
+    return picked;
+}
+
+} // namespace
+
+const char *SimdScan::instructionSet()
+{
+    return kernels().name;
+}
+
+qint64 SimdScan::asciiPrefix(const char *data, qint64 size)
+{
+    return kernels().asciiPrefix(reinterpret_cast<const unsigned char *>(data), size);
+}
+
+qint64 SimdScan::checkUtf8(const unsigned char *data, qint64 begin, qint64 end, bool *ascii)
+{
+    return kernels().checkUtf8(data, begin, end, ascii);
+}
+
+void SimdScan::swapBytes16(const char *src, char *dst, qint64 units)
+{
+    kernels().swapBytes16(src, dst, units);
+}
+
+void SimdScan::swapBytes32(const char *src, char *dst, qint64 units)
+{
+    kernels().swapBytes32(src, dst, units);
+}
+
+qint64 SimdScan::widenUtf16(const char16_t *src, char *dst, qint64 units)
+{
+    return kernels().widenUtf16(src, dst, units);
+}
+
+qint64 SimdScan::narrowUtf32(const char *src, char16_t *dst, qint64 units)
+{
+    return kernels().narrowUtf32(src, dst, units);
+}
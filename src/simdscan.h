@@ -0,0 +1,46 @@
+#ifndef SIMDSCAN_H
+#define SIMDSCAN_H
+
+#include <QtGlobal>
+
+/**
+ * @brief Vectorised byte kernels for encoding detection and conversion
+ *
+ * Each kernel has SSE2 and AVX2 kernels on x86, a NEON kernel on AArch64 and
+ * a scalar fallback everywhere else. The widest one the CPU supports is
+ * picked on first use; EDDY_SIMD=scalar or EDDY_SIMD=sse2 in the
+ * environment caps it, to compare them.
+ */
+class SimdScan
+{
+public:
+    // Name of the kernels in use: "avx2", "sse2", "neon" or "scalar"
+    static const char *instructionSet();
+
+    // Number of bytes before the first byte above 127
+    static qint64 asciiPrefix(const char *data, qint64 size);
+
+    // Check data[begin, end) a vector at a time against the UTF-8 rules of
+    // EncodingManager: every lead byte is followed by exactly the
+    // continuation bytes it announces. Reads back to data + begin - 3, so
+    // begin must be at least 3. Returns where it stopped, less than a vector
+    // before end, or -1 at invalid UTF-8; clears *ascii if it saw a byte
+    // above 127.
+    static qint64 checkUtf8(const unsigned char *data, qint64 begin, qint64 end, bool *ascii);
+
+    // Swap the bytes of each 16-bit or 32-bit unit of src into dst, which
+    // may be src
+    static void swapBytes16(const char *src, char *dst, qint64 units);
+    static void swapBytes32(const char *src, char *dst, qint64 units);
+
+    // Widen UTF-16 units to native UTF-32 in dst up to the first surrogate;
+    // returns the number of units widened
+    static qint64 widenUtf16(const char16_t *src, char *dst, qint64 units);
+
+    // Narrow native UTF-32 code points in src to UTF-16 up to the first one
+    // that needs a surrogate pair or is not a character; returns the number
+    // of code points narrowed
+    static qint64 narrowUtf32(const char *src, char16_t *dst, qint64 units);
+};
+
+#endif // SIMDSCAN_H
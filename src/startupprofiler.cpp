@@ -0,0 +1,113 @@
+#include "startupprofiler.h"
+#include <QCoreApplication>
+#include <QEvent>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QTimer>
+#include <QWidget>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+const char ProfileOption[] = "--profile-startup";
+
+// Give up if the window never paints (e.g. no usable platform plugin)
+const int FirstPaintTimeoutMs = 30000;
+
+void report(const QString &benchmark, const QString &metric, double value, const QString &unit)
+{
+    QJsonObject result;
+    result["benchmark"] = benchmark;
+    result["metric"] = metric;
+    result["value"] = value;
+    result["unit"] = unit;
+
+    QTextStream out(stdout);
+    out << QJsonDocument(result).toJson(QJsonDocument::Compact) << Qt::endl;
+}
+
+} // namespace
+
+StartupProfiler &StartupProfiler::instance()
+{
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+void StartupProfiler::start(int argc, char *argv[])
+{
+    const size_t optionLength = std::strlen(ProfileOption);
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], ProfileOption, optionLength) != 0) {
+            continue;
+        }
+
+        const char *rest = argv[i] + optionLength;
+        if (*rest == '\0') {
+            benchmarkName = "startup";
+        } else if (*rest == '=' && rest[1] != '\0') {
+            benchmarkName = QString("startup-%1").arg(QString::fromLocal8Bit(rest + 1));
+        } else {
+            continue;
+        }
+
+        enabled = true;
+        timer.start();
+        return;
+    }
+}
+
+void StartupProfiler::mark(const QString &phase)
+{
+    if (enabled && !painted) {
+        phases.append({phase, timer.nsecsElapsed()});
+    }
+}
+
+void StartupProfiler::watchFirstPaint(QWidget *window)
+{
+    if (!enabled) {
+        return;
+    }
+
+    // Paint events go to the child widgets, so watch them all until the first one
+    watchedWindow = window;
+    qApp->installEventFilter(this);
+    QTimer::singleShot(FirstPaintTimeoutMs, this, [this]() {
+        if (!painted) {
+            qWarning() << "Startup profile: the main window did not paint";
+            painted = true;
+            qApp->removeEventFilter(this);
+            QCoreApplication::exit(1);
+        }
+    });
+}
+
+bool StartupProfiler::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::Paint && !painted && watched->isWidgetType() &&
+        static_cast<QWidget *>(watched)->window() == watchedWindow) {
+        painted = true;
+        qApp->removeEventFilter(this);
+
+        // Let the rest of the frame paint before stopping the clock
+        QTimer::singleShot(0, this, &StartupProfiler::finish);
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void StartupProfiler::finish()
+{
+    phases.append({"first_paint", timer.nsecsElapsed()});
+
+    qint64 previous = 0;
+    for (const Phase &phase : std::as_const(phases)) {
+        report(benchmarkName, phase.name + "_ms", (phase.endNsecs - previous) / 1e6, "ms");
+        previous = phase.endNsecs;
+    }
+    report(benchmarkName, "total_ms", previous / 1e6, "ms");
+
+    QCoreApplication::exit(0);
+}
@@ -0,0 +1,61 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+class QWidget;
+
+/**
+ * @brief Startup trace enabled with --profile-startup[=label]
+ *
+ * Startup code marks the end of each phase; marks cost nothing when
+ * profiling is off. Once the main window has painted for the first time the
+ * duration of every phase and the total are printed as JSON lines, in the
+ * same format as eddy_perftest, and the application quits:
+ *   {"benchmark":"startup-cold","metric":"setup_menus_ms","value":12.3,"unit":"ms"}
+ */
+class StartupProfiler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static StartupProfiler &instance();
+
+    // Enable profiling if the command line asks for it; call first thing in main()
+    void start(int argc, char *argv[]);
+
+    bool isEnabled() const { return enabled; }
+
+    // Record the end of a startup phase
+    void mark(const QString &phase);
+
+    // Finish the trace on the first paint of window
+    void watchFirstPaint(QWidget *window);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    StartupProfiler() = default;
+    StartupProfiler(const StartupProfiler &) = delete;
+    StartupProfiler &operator=(const StartupProfiler &) = delete;
+
+    void finish();
+
+    struct Phase {
+        QString name;
+        qint64 endNsecs;
+    };
+
+    bool enabled = false;
+    bool painted = false;
+    QString benchmarkName;
+    QElapsedTimer timer;
+    QVector<Phase> phases;
+    QWidget *watchedWindow = nullptr;
+};
+
+#endif // STARTUPPROFILER_H
@@ -0,0 +1,297 @@
+#include "syntaxtokenizer.h"
+#include <QVarLengthArray>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Next match of a scanner (or of the keyword table) on the line being tokenized
+struct PendingMatch {
+    int start;
+    int end;
+    int category;
+    int priority;
+};
+
+const int NoMatch = std::numeric_limits<int>::max();
+
+// Same notion of a word character as \w and \b in QRegularExpression (ASCII)
+inline bool isWordChar(QChar c)
+{
+    ushort u = c.unicode();
+    return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') || u == '_';
+}
+
+PendingMatch nextMatch(const QRegularExpression &expression, const QString &text, int from)
+{
+    QRegularExpressionMatch match = expression.match(text, from);
+
+    // Empty matches carry no colour; look further along the line
+    while (match.hasMatch() && match.capturedLength() == 0) {
+        int next = int(match.capturedStart()) + 1;
+        if (next > text.length()) {
+            return {NoMatch, NoMatch, -1, 0};
+        }
+        match = expression.match(text, next);
+    }
+
+    if (!match.hasMatch()) {
+        return {NoMatch, NoMatch, -1, 0};
+    }
+    return {int(match.capturedStart()), int(match.capturedEnd()), -1, 0};
+}
+
+} // namespace
+
+SyntaxTokenizer::SyntaxTokenizer(const QMap<QString, QStringList> &patterns)
+{
+    const int categoryCount = patterns.size();
+    int category = 0;
+
+    for (auto it = patterns.begin(); it != patterns.end(); ++it, ++category) {
+        const QString &name = it.key();
+        categoryNames << name;
+
+        // Categories used to be applied in map order, later ones overwriting
+        // earlier ones. Comments and strings now outrank everything so the
+        // operators and keywords they contain no longer break them up.
+        int priority = category;
+        if (name == "comments") {
+            priority = categoryCount + 1;
+        } else if (name == "strings") {
+            priority = categoryCount;
+        }
+        categoryPriorities << priority;
+
+        QStringList alternatives;
+        for (const QString &pattern : it.value()) {
+            if (pattern.isEmpty()) {
+                continue;
+            }
+
+            QStringList words = plainWords(pattern);
+            if (!words.isEmpty()) {
+                for (const QString &word : words) {
+                    addKeyword(word, category);
+                }
+            } else if (needsOwnScanner(pattern)) {
+                addScanner(pattern, category, priority);
+            } else {
+                alternatives << "(?:" + pattern + ")";
+            }
+        }
+
+        if (alternatives.isEmpty()) {
+            continue;
+        }
+
+        QString alternation = alternatives.join('|');
+        if (QRegularExpression(alternation).isValid()) {
+            addScanner(alternation, category, priority);
+        } else {
+            // Keep the valid patterns of a category with a broken one
+            for (const QString &pattern : it.value()) {
+                if (!pattern.isEmpty() && plainWords(pattern).isEmpty() && !needsOwnScanner(pattern)) {
+                    addScanner(pattern, category, priority);
+                }
+            }
+        }
+    }
+
+    buildKeywordIndex();
+}
+
+void SyntaxTokenizer::addScanner(const QString &pattern, int category, int priority)
+{
+    Scanner scanner;
+    scanner.expression = QRegularExpression(pattern);
+    if (!scanner.expression.isValid()) {
+        qWarning() << "Invalid highlighting pattern for" << categoryNames.value(category) << ":"
+                   << pattern << "-" << scanner.expression.errorString();
+        return;
+    }
+    scanner.expression.optimize();
+    scanner.category = category;
+    scanner.priority = priority;
+    scanners.append(scanner);
+}
+
+void SyntaxTokenizer::addKeyword(const QString &word, int category)
+{
+    // A word listed in several categories keeps the one that wins on overlap
+    for (Keyword &keyword : keywords) {
+        if (keyword.word == word) {
+            if (categoryPriorities.at(category) > categoryPriorities.at(keyword.category)) {
+                keyword.category = category;
+            }
+            return;
+        }
+    }
+    keywords.append({word, category});
+}
+
+void SyntaxTokenizer::buildKeywordIndex()
+{
+    std::sort(keywords.begin(), keywords.end(), [](const Keyword &a, const Keyword &b) {
+        if (a.word.size() != b.word.size()) {
+            return a.word.size() < b.word.size();
+        }
+        return a.word < b.word;
+    });
+
+    int maxLength = keywords.isEmpty() ? 0 : int(keywords.last().word.size());
+    keywordLengthStart.fill(0, maxLength + 2);
+
+    int index = 0;
+    for (int length = 0; length <= maxLength + 1; ++length) {
+        keywordLengthStart[length] = index;
+        while (index < keywords.size() && keywords.at(index).word.size() == length) {
+            ++index;
+        }
+    }
+}
+
+int SyntaxTokenizer::keywordCategory(QStringView word) const
+{
+    const int length = int(word.size());
+    if (length + 1 >= keywordLengthStart.size()) {
+        return -1;
+    }
+
+    auto begin = keywords.begin() + keywordLengthStart.at(length);
+    auto end = keywords.begin() + keywordLengthStart.at(length + 1);
+    auto it = std::lower_bound(begin, end, word, [](const Keyword &keyword, QStringView value) {
+        return QStringView(keyword.word).compare(value) < 0;
+    });
+
+    if (it != end && QStringView(it->word) == word) {
+        return it->category;
+    }
+    return -1;
+}
+
+bool SyntaxTokenizer::needsOwnScanner(const QString &pattern)
+{
+    // Group numbers and names are only meaningful inside the original pattern
+    static const QRegularExpression groupReference(
+        R"(\\[1-9]|\\[gk]|\(\?P?<[A-Za-z_]|\(\?'|\(\?P[=>])");
+    return pattern.contains(groupReference);
+}
+
+QStringList SyntaxTokenizer::plainWords(const QString &pattern)
+{
+    // \bword\b and \b(word|word|...)\b, the forms keyword lists are written in
+    static const QRegularExpression singleWord(R"(^\\b([A-Za-z_]\w*)\\b$)");
+    static const QRegularExpression wordGroup(R"(^\\b\((?:\?:)?([A-Za-z_]\w*(?:\|[A-Za-z_]\w*)*)\)\\b$)");
+
+    QRegularExpressionMatch match = singleWord.match(pattern);
+    if (match.hasMatch()) {
+        return {match.captured(1)};
+    }
+
+    match = wordGroup.match(pattern);
+    if (match.hasMatch()) {
+        return match.captured(1).split('|');
+    }
+
+    return QStringList();
+}
+
+void SyntaxTokenizer::tokenize(const QString &text, QVector<TokenRun> &runs) const
+{
+    runs.clear();
+    if ((scanners.isEmpty() && keywords.isEmpty()) || text.isEmpty()) {
+        return;
+    }
+
+    const QChar *data = text.constData();
+    const int length = text.length();
+
+    // One pending match per scanner, plus one for the keyword table.
+    // A start of -1 means it still has to search from the current position.
+    const int keywordSlot = scanners.size();
+    const int slotCount = keywords.isEmpty() ? keywordSlot : keywordSlot + 1;
+    QVarLengthArray<PendingMatch, 16> pending(slotCount);
+    for (int i = 0; i < slotCount; ++i) {
+        pending[i] = {-1, -1, -1, 0};
+    }
+
+    int pos = 0;
+    while (pos < length) {
+        int best = -1;
+        for (int i = 0; i < slotCount; ++i) {
+            PendingMatch &match = pending[i];
+            if (match.start == NoMatch) {
+                continue;
+            }
+
+            if (match.start < pos) {
+                if (i == keywordSlot) {
+                    // Next identifier that is in the table; never start inside a word
+                    match = {NoMatch, NoMatch, -1, 0};
+                    int j = pos;
+                    if (j > 0 && isWordChar(data[j - 1])) {
+                        while (j < length && isWordChar(data[j])) {
+                            ++j;
+                        }
+                    }
+                    while (j < length) {
+                        if (!isWordChar(data[j])) {
+                            ++j;
+                            continue;
+                        }
+                        int wordStart = j;
+                        while (j < length && isWordChar(data[j])) {
+                            ++j;
+                        }
+                        int category = keywordCategory(QStringView(data + wordStart, j - wordStart));
+                        if (category >= 0) {
+                            match = {wordStart, j, category, categoryPriorities.at(category)};
+                            break;
+                        }
+                    }
+                } else {
+                    const Scanner &scanner = scanners.at(i);
+                    match = nextMatch(scanner.expression, text, pos);
+                    match.category = scanner.category;
+                    match.priority = scanner.priority;
+                }
+
+                if (match.start == NoMatch) {
+                    continue;
+                }
+            }
+
+            if (best < 0 || match.start < pending[best].start ||
+                (match.start == pending[best].start && match.priority > pending[best].priority)) {
+                best = i;
+            }
+        }
+
+        if (best < 0) {
+            break;
+        }
+
+        const PendingMatch winner = pending[best];
+        runs.append({winner.start, winner.end - winner.start, winner.category});
+
+        // A longer match of another category at the same position keeps its tail
+        int tail = -1;
+        for (int i = 0; i < slotCount; ++i) {
+            if (i == best || pending[i].start != winner.start || pending[i].end <= winner.end) {
+                continue;
+            }
+            if (tail < 0 || pending[i].end > pending[tail].end ||
+                (pending[i].end == pending[tail].end && pending[i].priority > pending[tail].priority)) {
+                tail = i;
+            }
+        }
+
+        pos = winner.end;
+        if (tail >= 0) {
+            runs.append({winner.end, pending[tail].end - winner.end, pending[tail].category});
+            pos = pending[tail].end;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef SYNTAXTOKENIZER_H
+#define SYNTAXTOKENIZER_H
+
+#include <QString>
+#include <QStringList>
+#include <QRegularExpression>
+#include <QVector>
+#include <QMap>
+#include <QStringView>
+
+// A highlighted span of a line, produced in left-to-right order
+struct TokenRun {
+    int start;
+    int length;
+    int category;  // Index into SyntaxTokenizer::categories()
+};
+
+/**
+ * @brief Single-pass tokenizer for the pattern categories of a language
+ *
+ * All patterns of a category are merged into one alternation, so a line is
+ * scanned by one regular expression per category instead of one per
+ * pattern. Patterns that cannot share an alternation (back-references,
+ * named groups) get their own scanner. The scanners' next matches are
+ * merged left to right: the earliest match wins, and on a tie the category
+ * with the higher priority wins. Comments and strings rank highest, the
+ * remaining categories keep the order in which they used to overwrite each
+ * other. If a lower priority match at the same position is longer, its tail
+ * is still emitted, so "class Foo" keeps both the keyword and class colours.
+ *
+ * Plain word patterns such as "\\bint\\b" or "\\b(if|else)\\b" are not compiled
+ * at all. They go into a flat table sorted by length and text, and each
+ * identifier on the line is classified with one lookup in that table.
+ *
+ * Tokenizers hold no per-line state and are shared between highlighters.
+ */
+class SyntaxTokenizer
+{
+public:
+    explicit SyntaxTokenizer(const QMap<QString, QStringList> &patterns);
+
+    // Category names, in the order used by TokenRun::category
+    const QStringList &categories() const { return categoryNames; }
+
+    // Number of regular expressions scanned per line
+    int scannerCount() const { return scanners.size(); }
+
+    // Number of words classified by table lookup instead of a regex
+    int keywordCount() const { return keywords.size(); }
+
+    // Tokenize a single line; runs is cleared first
+    void tokenize(const QString &text, QVector<TokenRun> &runs) const;
+
+private:
+    struct Scanner {
+        QRegularExpression expression;
+        int category;
+        int priority;  // Higher wins when two matches start at the same position
+    };
+
+    struct Keyword {
+        QString word;
+        int category;
+    };
+
+    QStringList categoryNames;
+    QVector<int> categoryPriorities;
+    QVector<Scanner> scanners;
+
+    QVector<Keyword> keywords;        // Sorted by length, then text
+    QVector<int> keywordLengthStart;  // Words of length n are [start[n], start[n + 1])
+
+    void addScanner(const QString &pattern, int category, int priority);
+    void addKeyword(const QString &word, int category);
+    void buildKeywordIndex();
+    int keywordCategory(QStringView word) const;
+    static bool needsOwnScanner(const QString &pattern);
+    static QStringList plainWords(const QString &pattern);
+};
+
+#endif // SYNTAXTOKENIZER_H
@@ -0,0 +1,69 @@
+// Eddy language pack compiler
+//
+// Usage: eddy_langpack <output.pack> <language.json> [...]
+//
+// Parses each language definition and writes them all into one binary pack
+// (see src/languagepack.h). Run by the build; fails on any invalid file so a
+// broken definition never ships.
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDebug>
+#include "languageloader.h"
+#include "languagepack.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const QStringList arguments = app.arguments().mid(1);
+    if (arguments.size() < 2) {
+        qCritical() << "Usage: eddy_langpack <output.pack> <language.json> [...]";
+        return 1;
+    }
+
+    LanguageLoader loader;
+    QVector<LanguagePack::Language> languages;
+
+    for (const QString &filePath : arguments.mid(1)) {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCritical() << "Cannot open language file:" << filePath;
+            return 1;
+        }
+        const QByteArray contents = file.readAll();
+
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(contents, &error);
+        if (error.error != QJsonParseError::NoError) {
+            qCritical() << "JSON parse error in" << filePath << ":" << error.errorString();
+            return 1;
+        }
+
+        LanguageDefinition langDef = loader.parseLanguageDefinition(doc.object());
+        if (!langDef.isValid()) {
+            qCritical() << "Language file has no name:" << filePath;
+            return 1;
+        }
+
+        LanguagePack::Language language;
+        language.name = langDef.name;
+        language.displayName = langDef.displayName;
+        language.fileExtensions = langDef.fileExtensions;
+        language.sourceFile = QFileInfo(filePath).fileName();
+        language.sourceHash = LanguagePack::hashSource(contents);
+        language.definition = LanguagePack::encodeDefinition(langDef);
+        languages.append(language);
+    }
+
+    QSaveFile output(arguments.first());
+    if (!output.open(QIODevice::WriteOnly) || output.write(LanguagePack::write(languages)) < 0 || !output.commit()) {
+        qCritical() << "Cannot write language pack:" << arguments.first();
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,1124 @@
+// Eddy performance harness
+//
+// Usage: QT_QPA_PLATFORM=offscreen eddy_perftest [benchmark ...]
+//
+// Runs every benchmark (or only the named ones) and prints one JSON object
+// per measurement on stdout, e.g.
+//   {"benchmark":"tab-creation","metric":"ms_per_tab","value":0.41,"unit":"ms"}
+//
+// Results that are checked as well warn on stderr when wrong, and the run
+// then exits with status 1.
+
+#include <QApplication>
+#include <QBuffer>
+#include <QColor>
+#include <QDir>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QImage>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QSharedPointer>
+#include <QStringDecoder>
+#include <QStringEncoder>
+#include <QTemporaryFile>
+#include <QTextBlock>
+#include <QTextCharFormat>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+#include <QVector>
+#include <atomic>
+#include <cstdlib>
+#include "bracketindex.h"
+#include "codeeditor.h"
+#include "encodingmanager.h"
+#include "fileloader.h"
+#include "jsonsyntaxhighlighter.h"
+#include "languageloader.h"
+#include "languagepack.h"
+#include "languageregistry.h"
+#include "lineindex.h"
+#include "minimaprenderer.h"
+#include "piecetable.h"
+#include "searchindex.h"
+#include "simdscan.h"
+
+// Heap allocation counter for the benchmarks that must not allocate. Qt
+// containers allocate with malloc, so malloc itself is wrapped (glibc only).
+namespace {
+std::atomic<bool> countingAllocations{false};
+std::atomic<qint64> allocationCount{0};
+} // namespace
+
+#if defined(__GLIBC__)
+#define EDDY_COUNT_ALLOCATIONS 1
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size)
+{
+    if (countingAllocations.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    if (countingAllocations.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    if (countingAllocations.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_realloc(pointer, size);
+}
+}
+#endif
+
+namespace {
+
+// Set by any check that fails, so the run exits non-zero
+bool checksFailed = false;
+
+QDebug failure()
+{
+    checksFailed = true;
+    return qWarning();
+}
+
+void report(const QString &benchmark, const QString &metric, double value, const QString &unit)
+{
+    QJsonObject result;
+    result["benchmark"] = benchmark;
+    result["metric"] = metric;
+    result["value"] = value;
+    result["unit"] = unit;
+
+    QTextStream out(stdout);
+    out << QJsonDocument(result).toJson(QJsonDocument::Compact) << Qt::endl;
+}
+
+// Cost of getting every bundled language definition at startup: decoding
+// the embedded language pack against reading and parsing the JSON files.
+void benchLanguagePack()
+{
+    QElapsedTimer timer;
+    timer.start();
+    QVector<LanguagePack::Language> packed;
+    LanguagePack::read(LanguagePack::embeddedData(), packed);
+    for (const LanguagePack::Language &language : std::as_const(packed)) {
+        LanguageDefinition langDef = LanguagePack::decodeDefinition(language.definition);
+        Q_UNUSED(langDef);
+    }
+    double packMs = timer.nsecsElapsed() / 1e6;
+
+    QDir dir(EDDY_LANGUAGES_DIR);
+    const QStringList jsonFiles = dir.entryList(QStringList() << "*.json", QDir::Files);
+    LanguageLoader loader;
+    timer.restart();
+    for (const QString &fileName : jsonFiles) {
+        LanguageDefinition langDef = loader.parseLanguageDefinition(LanguageLoader::readLanguageFile(dir.absoluteFilePath(fileName)));
+        Q_UNUSED(langDef);
+    }
+    double jsonMs = timer.nsecsElapsed() / 1e6;
+
+    report("language-pack", "packed_languages", packed.size(), "languages");
+    report("language-pack", "pack_ms", packMs, "ms");
+    report("language-pack", "json_ms", jsonMs, "ms");
+}
+
+// Simulates restoring a session with many tabs: every tab gets its own
+// document and highlighter. Language files must be read only once.
+void benchTabCreation()
+{
+    const int tabCount = 40;
+    const QStringList fileNames = {"main.cpp", "script.py", "lib.rs", "index.html", "notes.md"};
+
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+    int readsBefore = LanguageLoader::fileReadCount();
+
+    QVector<QTextDocument *> documents;
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0; i < tabCount; ++i) {
+        QTextDocument *document = new QTextDocument();
+        JsonSyntaxHighlighter *highlighter = new JsonSyntaxHighlighter(document);
+        highlighter->loadLanguages(EDDY_LANGUAGES_DIR);
+        highlighter->setLanguageFromFilename(fileNames.at(i % fileNames.size()));
+        documents.append(document);
+    }
+
+    double elapsed = timer.nsecsElapsed() / 1e6;
+    report("tab-creation", "tabs", tabCount, "tabs");
+    report("tab-creation", "ms_per_tab", elapsed / tabCount, "ms");
+    report("tab-creation", "language_file_reads", LanguageLoader::fileReadCount() - readsBefore, "files");
+
+    qDeleteAll(documents);
+}
+
+QString generateSource(const QStringList &snippet, int lineCount)
+{
+    QStringList lines;
+    lines.reserve(lineCount);
+    for (int i = 0; i < lineCount; ++i) {
+        lines << snippet.at(i % snippet.size());
+    }
+    return lines.join('\n');
+}
+
+// Highlights a generated 100k-line document and reports the per-line cost of
+// the tokenizer alone and of a full QSyntaxHighlighter pass.
+void benchHighlightLanguage(const QString &benchmark, const QString &language, const QStringList &snippet)
+{
+    const int lineCount = 100000;
+    QString source = generateSource(snippet, lineCount);
+
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+    QSharedPointer<const HighlightingRuleSet> rules = LanguageRegistry::instance().getHighlightingRules(language, false);
+    if (!rules) {
+        failure() << "Unknown language" << language;
+        return;
+    }
+
+    const QStringList lines = source.split('\n');
+    QVector<TokenRun> runs;
+    qint64 tokenCount = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &line : lines) {
+        rules->tokenizer->tokenize(line, runs);
+        tokenCount += runs.size();
+    }
+    double tokenizeMs = timer.nsecsElapsed() / 1e6;
+
+    QTextDocument document;
+    document.setPlainText(source);
+    JsonSyntaxHighlighter highlighter(&document);
+
+    timer.restart();
+    highlighter.setLanguage(language);
+    double highlightMs = timer.nsecsElapsed() / 1e6;
+
+    report(benchmark, "lines", lineCount, "lines");
+    report(benchmark, "scanners", rules->tokenizer->scannerCount(), "regexes");
+    report(benchmark, "keywords", rules->tokenizer->keywordCount(), "words");
+    report(benchmark, "tokens", tokenCount, "tokens");
+    report(benchmark, "tokenize_us_per_line", tokenizeMs * 1000.0 / lineCount, "us");
+    report(benchmark, "highlight_us_per_line", highlightMs * 1000.0 / lineCount, "us");
+}
+
+QStringList cppSnippet()
+{
+    return {
+        "#include <vector>",
+        "",
+        "/* Accumulates values */",
+        "class Accumulator : public Base {",
+        "public:",
+        "    explicit Accumulator(int initial = 0x10) : total(initial) {}",
+        "    void add(const std::vector<double> &values) {",
+        "        for (auto value : values) { total += static_cast<int>(value * 2.5f); }",
+        "        if (total > 100 && !values.empty()) { log(\"overflow: %d\", total); } // clamp",
+        "    }",
+        "private:",
+        "    int total;",
+        "};",
+    };
+}
+
+void benchHighlightCpp()
+{
+    benchHighlightLanguage("highlight-cpp", "CPlusPlus", cppSnippet());
+}
+
+void benchHighlightPython()
+{
+    benchHighlightLanguage("highlight-python", "Python", {
+        "import os",
+        "",
+        "class Accumulator(Base):",
+        "    \"\"\"Accumulates values\"\"\"",
+        "    def __init__(self, initial=0x10):",
+        "        self.total = initial  # running sum",
+        "",
+        "    def add(self, values):",
+        "        for value in values:",
+        "            if value is not None and self.total < 100:",
+        "                self.total += int(value * 2.5)",
+        "        return f'total: {self.total}'",
+    });
+}
+
+// Runs the multiline comment state machine over every line the way
+// highlightBlock does, once to warm up and once while counting heap
+// allocations, which must be zero. For comparison, also times the old
+// per-block setup of a format and two escaped regular expressions.
+void benchCommentScanner()
+{
+    const QString benchmark = "comment-scanner";
+    const int lineCount = 100000;
+    const QStringList lines = generateSource(cppSnippet(), lineCount).split('\n');
+
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+    QSharedPointer<const HighlightingRuleSet> rules = LanguageRegistry::instance().getHighlightingRules("CPlusPlus", false);
+    if (!rules) {
+        failure() << "Unknown language CPlusPlus";
+        return;
+    }
+
+    QVector<TokenRun> spans;
+    int state = -1;
+    for (const QString &line : lines) {
+        state = rules->comments.scan(line, state, &spans);
+    }
+
+    qint64 spanCount = 0;
+    allocationCount = 0;
+    countingAllocations = true;
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &line : lines) {
+        state = rules->comments.scan(line, state, &spans);
+        spanCount += spans.size();
+    }
+    double scanMs = timer.nsecsElapsed() / 1e6;
+    countingAllocations = false;
+
+    qint64 legacyMatches = 0;
+    timer.restart();
+    for (const QString &line : lines) {
+        QTextCharFormat format;
+        format.setForeground(QColor("#008000"));
+        QRegularExpression startExpression(QRegularExpression::escape("/*"));
+        QRegularExpression endExpression(QRegularExpression::escape("*/"));
+        legacyMatches += line.indexOf(startExpression) >= 0 ? 1 : 0;
+    }
+    Q_UNUSED(legacyMatches);
+    double legacyMs = timer.nsecsElapsed() / 1e6;
+
+    report(benchmark, "lines", lineCount, "lines");
+    report(benchmark, "spans", spanCount, "spans");
+    report(benchmark, "scan_us_per_line", scanMs * 1000.0 / lineCount, "us");
+    report(benchmark, "legacy_setup_us_per_line", legacyMs * 1000.0 / lineCount, "us");
+#ifdef EDDY_COUNT_ALLOCATIONS
+    report(benchmark, "allocations_per_block", double(allocationCount) / lineCount, "allocations");
+#endif
+}
+
+// Opens a large C++ document in lazy mode: reports how long setLanguage
+// blocks (time until the editor is interactive) against a full eager pass,
+// and how long the idle chunks take to finish the document.
+void benchLazyHighlight()
+{
+    const int lineCount = 200000;
+    QString source = generateSource(cppSnippet(), lineCount);
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+
+    // Same order as opening a file: highlighter first, then text, then language
+    QTextDocument eagerDocument;
+    JsonSyntaxHighlighter eagerHighlighter(&eagerDocument);
+    eagerDocument.setPlainText(source);
+    QElapsedTimer timer;
+    timer.start();
+    eagerHighlighter.setLanguage("CPlusPlus");
+    double eagerMs = timer.nsecsElapsed() / 1e6;
+
+    QTextDocument document;
+    JsonSyntaxHighlighter highlighter(&document);
+    highlighter.setLazyHighlighting(true);
+    document.setPlainText(source);
+    timer.restart();
+    highlighter.setLanguage("CPlusPlus");
+    double interactiveMs = timer.nsecsElapsed() / 1e6;
+
+    while (highlighter.hasPendingBlocks()) {
+        QCoreApplication::processEvents();
+    }
+    double completeMs = timer.nsecsElapsed() / 1e6;
+
+    report("lazy-highlight", "lines", lineCount, "lines");
+    report("lazy-highlight", "eager_ms", eagerMs, "ms");
+    report("lazy-highlight", "interactive_ms", interactiveMs, "ms");
+    report("lazy-highlight", "complete_ms", completeMs, "ms");
+}
+
+// Types into the top of a large lazily highlighted document while the rest
+// is still being highlighted, and reports the cost of each keystroke.
+void benchTypingLatency()
+{
+    const int lineCount = 200000;
+    const int keystrokes = 200;
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+
+    QTextDocument document;
+    JsonSyntaxHighlighter highlighter(&document);
+    highlighter.setLazyHighlighting(true);
+    document.setPlainText(generateSource(cppSnippet(), lineCount));
+    highlighter.setLanguage("CPlusPlus");
+
+    QTextCursor cursor(document.findBlockByNumber(5));
+    cursor.movePosition(QTextCursor::EndOfBlock);
+
+    double totalMs = 0;
+    double worstMs = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < keystrokes; ++i) {
+        timer.restart();
+        cursor.insertText(i % 2 ? "x" : "/");
+        double ms = timer.nsecsElapsed() / 1e6;
+        totalMs += ms;
+        worstMs = qMax(worstMs, ms);
+
+        // Let the idle pass and the worker run between keystrokes
+        QElapsedTimer gap;
+        gap.start();
+        while (!gap.hasExpired(20)) {
+            QCoreApplication::processEvents();
+        }
+    }
+
+    report("typing-latency", "keystrokes", keystrokes, "keystrokes");
+    report("typing-latency", "avg_keystroke_ms", totalMs / keystrokes, "ms");
+    report("typing-latency", "max_keystroke_ms", worstMs, "ms");
+}
+
+// Matches the braces around a large highlighted document from both ends:
+// first on blocks the highlighter has indexed, then on a fresh document
+// whose blocks are indexed on demand.
+void benchBracketMatch()
+{
+    // Whole snippets only, so the braces inside balance
+    const int lineCount = int(cppSnippet().size()) * 7500;
+    const QString source = "{\n" + generateSource(cppSnippet(), lineCount) + "\n}";
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+
+    QTextDocument document;
+    JsonSyntaxHighlighter highlighter(&document);
+    document.setPlainText(source);
+    highlighter.setLanguage("CPlusPlus");
+    const int last = document.characterCount() - 2;
+
+    QElapsedTimer timer;
+    timer.start();
+    const int forward = BracketIndex::findMatch(&document, 0);
+    const int backward = BracketIndex::findMatch(&document, last);
+    double indexedMs = timer.nsecsElapsed() / 1e6;
+    if (forward != last || backward != 0) {
+        failure() << "bracket-match: unexpected match" << forward << backward;
+    }
+
+    QTextDocument plainDocument;
+    plainDocument.setPlainText(source);
+    timer.restart();
+    BracketIndex::findMatch(&plainDocument, 0);
+    double firstUseMs = timer.nsecsElapsed() / 1e6;
+
+    report("bracket-match", "lines", lineCount, "lines");
+    report("bracket-match", "indexed_ms", indexedMs / 2, "ms");
+    report("bracket-match", "first_use_ms", firstUseMs, "ms");
+}
+
+// Opens and closes a block comment near the top of a fully highlighted
+// document. Every line below changes state; only the visible ones should be
+// reformatted during the keystroke, the rest are queued for idle time.
+void benchCommentCascade()
+{
+    const int lineCount = 50000;
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+
+    QTextDocument document;
+    JsonSyntaxHighlighter highlighter(&document);
+    document.setPlainText(generateSource(cppSnippet(), lineCount));
+    highlighter.setLanguage("CPlusPlus");
+    highlighter.setVisibleBlockRange(0, 60);
+
+    QTextCursor cursor(document.findBlockByNumber(5));
+    QElapsedTimer timer;
+    timer.start();
+    cursor.insertText("/*");
+    double openMs = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    while (highlighter.hasPendingBlocks()) {
+        QCoreApplication::processEvents();
+    }
+    double settleMs = timer.nsecsElapsed() / 1e6;
+
+    cursor.movePosition(QTextCursor::StartOfBlock);
+    cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, 2);
+    timer.restart();
+    cursor.removeSelectedText();
+    double closeMs = timer.nsecsElapsed() / 1e6;
+
+    report("comment-cascade", "lines", lineCount, "lines");
+    report("comment-cascade", "open_keystroke_ms", openMs, "ms");
+    report("comment-cascade", "close_keystroke_ms", closeMs, "ms");
+    report("comment-cascade", "idle_settle_ms", settleMs, "ms");
+}
+
+// Folds and unfolds every range of a large editor. Both run as one pass over
+// the blocks with a single relayout, however many folds there are.
+void benchFoldAll()
+{
+    const int lineCount = int(cppSnippet().size()) * 7500;
+
+    CodeEditor editor;
+    editor.resize(800, 600);
+    editor.setPlainText(generateSource(cppSnippet(), lineCount));
+
+    QElapsedTimer timer;
+    timer.start();
+    editor.foldAll();
+    double foldMs = timer.nsecsElapsed() / 1e6;
+    const int folds = int(editor.getFoldedLines().size());
+
+    timer.restart();
+    editor.unfoldAll();
+    double unfoldMs = timer.nsecsElapsed() / 1e6;
+
+    report("fold-all", "lines", lineCount, "lines");
+    report("fold-all", "folds", folds, "folds");
+    report("fold-all", "fold_all_ms", foldMs, "ms");
+    report("fold-all", "unfold_all_ms", unfoldMs, "ms");
+}
+
+// Scrolls a shown editor a few lines per frame, painting text and gutter as
+// the event loop would. The gutter blits what stays on screen and draws the
+// exposed lines from cached pixmaps.
+void benchGutterScroll()
+{
+    const int lineCount = 100000;
+    const int frames = 500;
+
+    CodeEditor editor;
+    editor.resize(800, 1000);
+    editor.setPlainText(generateSource(cppSnippet(), lineCount));
+    editor.show();
+    QCoreApplication::processEvents();
+
+    QScrollBar *scrollBar = editor.verticalScrollBar();
+    QElapsedTimer timer;
+    timer.start();
+    for (int frame = 0; frame < frames; ++frame) {
+        scrollBar->setValue(scrollBar->value() + 3);
+        QCoreApplication::processEvents();
+    }
+    double elapsedMs = timer.nsecsElapsed() / 1e6;
+
+    report("gutter-scroll", "frames", frames, "frames");
+    report("gutter-scroll", "ms_per_frame", elapsedMs / frames, "ms");
+}
+
+// Rasterises a highlighted 100k-line document into a minimap image, one row
+// per line and one pixel per character, coloured from the layout formats the
+// highlighter already produced. Target: under 50 ms for the whole document.
+void benchMinimapSyntax()
+{
+    const int lineCount = 100000;
+    const int width = 120;
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+
+    QTextDocument document;
+    JsonSyntaxHighlighter highlighter(&document);
+    document.setPlainText(generateSource(cppSnippet(), lineCount));
+    highlighter.setLanguage("CPlusPlus");
+
+    QImage image(width, lineCount, QImage::Format_RGB32);
+    image.fill(MinimapRenderer::Background);
+
+    QElapsedTimer timer;
+    timer.start();
+    int y = 0;
+    for (QTextBlock block = document.begin(); block.isValid(); block = block.next(), ++y) {
+        MinimapRenderer::drawLine(reinterpret_cast<QRgb *>(image.scanLine(y)), width, block, true);
+    }
+    double syntaxMs = timer.nsecsElapsed() / 1e6;
+
+    image.fill(MinimapRenderer::Background);
+    timer.restart();
+    y = 0;
+    for (QTextBlock block = document.begin(); block.isValid(); block = block.next(), ++y) {
+        MinimapRenderer::drawLine(reinterpret_cast<QRgb *>(image.scanLine(y)), width, block, false);
+    }
+    double plainMs = timer.nsecsElapsed() / 1e6;
+
+    report("minimap-syntax", "lines", lineCount, "lines");
+    report("minimap-syntax", "syntax_ms", syntaxMs, "ms");
+    report("minimap-syntax", "plain_ms", plainMs, "ms");
+}
+
+// Downsamples a highlighted 100k-line document onto a 1000-row minimap: one
+// summary per line, merged per row as the worker thread does, then the
+// single-row merge an edit costs.
+void benchMinimapLod()
+{
+    const int lineCount = 100000;
+    const int rowCount = 1000;
+    LanguageRegistry::instance().ensureLoaded(EDDY_LANGUAGES_DIR);
+
+    QTextDocument document;
+    JsonSyntaxHighlighter highlighter(&document);
+    document.setPlainText(generateSource(cppSnippet(), lineCount));
+    highlighter.setLanguage("CPlusPlus");
+
+    QVector<MinimapRenderer::Summary> lines(lineCount);
+    QElapsedTimer timer;
+    timer.start();
+    int line = 0;
+    for (QTextBlock block = document.begin(); block.isValid(); block = block.next(), ++line) {
+        lines[line] = MinimapRenderer::summarizeLine(block, true);
+    }
+    double summarizeMs = timer.nsecsElapsed() / 1e6;
+
+    QVector<MinimapRenderer::Summary> rows(rowCount);
+    timer.restart();
+    MinimapRenderer::summarizeRows(lines, rowCount, 0, rowCount - 1, rows.data());
+    double mergeMs = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    MinimapRenderer::summarizeRows(lines, rowCount, rowCount / 2, rowCount / 2, rows.data() + rowCount / 2);
+    double rowUs = timer.nsecsElapsed() / 1e3;
+
+    report("minimap-lod", "lines", lineCount, "lines");
+    report("minimap-lod", "summarize_lines_ms", summarizeMs, "ms");
+    report("minimap-lod", "merge_rows_ms", mergeMs, "ms");
+    report("minimap-lod", "merge_one_row_us", rowUs, "us");
+}
+
+// Finds the matching lines of a ~50 MB log-like buffer the way the minimap's
+// search worker does: one pass over a raw-text snapshot, no copy per line.
+void benchMinimapSearch()
+{
+    const QStringList logLines = {
+        "2024-03-01 12:00:01.123 INFO  [worker-3] request completed in 12 ms (status=200, bytes=5120)",
+        "2024-03-01 12:00:01.456 DEBUG [worker-1] cache lookup key=session:8f3a91 hit=true",
+        "2024-03-01 12:00:02.789 WARN  [worker-7] slow query took 950 ms: SELECT * FROM orders",
+        "2024-03-01 12:00:03.012 INFO  [worker-2] request completed in 8 ms (status=200, bytes=2048)",
+        "2024-03-01 12:00:03.345 ERROR [worker-5] connection reset by peer while reading response",
+    };
+    const int lineCount = 600000;
+    QStringList lines;
+    lines.reserve(lineCount);
+    for (int i = 0; i < lineCount; ++i) {
+        lines << logLines.at(i % logLines.size());
+    }
+    const QString snapshot = lines.join(QChar::ParagraphSeparator);
+    const auto never = []() { return false; };
+
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<int> plainHits = SearchIndex({"ERROR"}).matchingLines(snapshot, never);
+    double plainMs = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    const QVector<int> wordHits = SearchIndex({"query", false, true, false}).matchingLines(snapshot, never);
+    double wordMs = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    const QVector<int> regexHits = SearchIndex({"took \\d{3,} ms", true, false, true}).matchingLines(snapshot, never);
+    double regexMs = timer.nsecsElapsed() / 1e6;
+
+    report("minimap-search", "text_mb", snapshot.size() / 1e6, "MB");
+    report("minimap-search", "hits", plainHits.size(), "lines");
+    report("minimap-search", "plain_ms", plainMs, "ms");
+    report("minimap-search", "whole_word_ms", wordMs, "ms");
+    report("minimap-search", "regex_ms", regexMs, "ms");
+    if (wordHits.size() != regexHits.size()) {
+        failure() << "minimap-search: unexpected hit counts" << wordHits.size() << regexHits.size();
+    }
+}
+
+void benchLargeFileIndex()
+{
+    const QByteArray logLine = "2024-03-01 12:00:01.123 INFO  [worker-3] request completed in 12 ms (status=200, bytes=5120)\n";
+    const qint64 targetBytes = 200 * 1024 * 1024;
+    QByteArray buffer;
+    buffer.reserve(targetBytes + logLine.size());
+    while (buffer.size() < targetBytes) {
+        buffer.append(logLine);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    LineIndex index(buffer.constData(), buffer.size());
+    index.build();
+    double buildMs = timer.nsecsElapsed() / 1e6;
+
+    // Random lookups, the way scrolling and search results use the index
+    const int lookups = 100000;
+    const qint64 lineCount = index.lineCount();
+    qint64 checksum = 0;
+    timer.restart();
+    for (int i = 0; i < lookups; ++i) {
+        checksum += index.lineStart((qint64(i) * 7919) % lineCount);
+    }
+    double lineStartUs = timer.nsecsElapsed() / 1e3 / lookups;
+
+    timer.restart();
+    for (int i = 0; i < lookups; ++i) {
+        checksum += index.lineAt((qint64(i) * 104729) % buffer.size());
+    }
+    double lineAtUs = timer.nsecsElapsed() / 1e3 / lookups;
+
+    const double indexBytes = double(lineCount / LineIndex::Stride + 1) * sizeof(qint64);
+    report("large-file-index", "file_mb", buffer.size() / 1e6, "MB");
+    report("large-file-index", "lines", lineCount, "lines");
+    report("large-file-index", "build_ms", buildMs, "ms");
+    report("large-file-index", "build_mb_per_s", buffer.size() / 1e6 / (buildMs / 1e3), "MB/s");
+    report("large-file-index", "index_kb", indexBytes / 1024, "KB");
+    report("large-file-index", "line_start_us", lineStartUs, "us");
+    report("large-file-index", "line_at_us", lineAtUs, "us");
+    if (index.lineStart(lineCount - 1) != buffer.size() || checksum < 0) {
+        failure() << "large-file-index: last line does not start at the end of the buffer";
+    }
+}
+
+void benchPieceTableEdit()
+{
+    const QByteArray logLine = "2024-03-01 12:00:01.123 INFO  [worker-3] request completed in 12 ms (status=200, bytes=5120)\n";
+    const qint64 targetBytes = 200 * 1024 * 1024;
+    QByteArray buffer;
+    buffer.reserve(targetBytes + logLine.size());
+    while (buffer.size() < targetBytes) {
+        buffer.append(logLine);
+    }
+    LineIndex index(buffer.constData(), buffer.size());
+    index.build();
+    PieceTable table(&index);
+
+    // Edits scattered over the file: a line inserted, then a word deleted
+    const int edits = 5000;
+    qint64 insertedBytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < edits; ++i) {
+        const qint64 offset = (qint64(i) * 1000003) % table.size();
+        if (i % 2 == 0) {
+            const QByteArray line = "inserted line\n";
+            table.replace(offset, 0, line);
+            insertedBytes += line.size();
+        } else {
+            table.replace(offset, 5, QByteArray());
+        }
+    }
+    double editUs = timer.nsecsElapsed() / 1e3 / edits;
+
+    // Typing at one place extends a single piece
+    const int keystrokes = 2000;
+    const qint64 typingAt = table.lineStart(table.lineCount() / 2);
+    timer.restart();
+    for (int i = 0; i < keystrokes; ++i) {
+        table.replace(typingAt + i, 0, "a");
+    }
+    double keystrokeUs = timer.nsecsElapsed() / 1e3 / keystrokes;
+    insertedBytes += keystrokes;
+
+    // Line lookups across the edited table, as painting and scrolling do
+    const int lookups = 2000;
+    const qint64 lineCount = table.lineCount();
+    qint64 checksum = 0;
+    timer.restart();
+    for (int i = 0; i < lookups; ++i) {
+        const qint64 start = table.lineStart((qint64(i) * 7919) % lineCount);
+        checksum += table.lineBytes(start, 16 * 1024).size();
+    }
+    double lineUs = timer.nsecsElapsed() / 1e3 / lookups;
+
+    const qint64 editedSize = table.size();
+    QBuffer edited;
+    edited.open(QIODevice::WriteOnly);
+    timer.restart();
+    table.write(&edited);
+    double writeMs = timer.nsecsElapsed() / 1e6;
+
+    timer.restart();
+    int undone = 0;
+    while (table.canUndo()) {
+        table.undo();
+        ++undone;
+    }
+    double undoMs = timer.nsecsElapsed() / 1e6;
+
+    report("piece-table-edit", "file_mb", buffer.size() / 1e6, "MB");
+    report("piece-table-edit", "edit_us", editUs, "us");
+    report("piece-table-edit", "keystroke_us", keystrokeUs, "us");
+    report("piece-table-edit", "line_lookup_us", lineUs, "us");
+    report("piece-table-edit", "write_ms", writeMs, "ms");
+    report("piece-table-edit", "undo_all_ms", undoMs, "ms");
+    report("piece-table-edit", "undo_steps", undone, "steps");
+    report("piece-table-edit", "added_kb", insertedBytes / 1024.0, "KB");
+
+    QBuffer restored;
+    restored.open(QIODevice::WriteOnly);
+    table.write(&restored);
+    if (edited.data().size() != editedSize || editedSize != buffer.size() + insertedBytes - (edits / 2) * 5 ||
+        checksum < 0) {
+        failure() << "piece-table-edit: edited size does not match the edits made";
+    }
+    if (table.isModified() || restored.data() != buffer) {
+        failure() << "piece-table-edit: undoing every edit did not restore the original";
+    }
+}
+
+void benchEncodingDetect()
+{
+    const QByteArray logLine = "2024-03-01 12:00:01.123 INFO  [worker-3] caf\xc3\xa9 request completed in 12 ms (status=200)\n";
+    const qint64 targetBytes = 200 * 1024 * 1024;
+    QByteArray buffer;
+    buffer.reserve(targetBytes + logLine.size());
+    while (buffer.size() < targetBytes) {
+        buffer.append(logLine);
+    }
+
+    // Detection reads a bounded sample, whatever the size of the buffer
+    const int detections = 1000;
+    EncodingManager::Detection detection = {EncodingManager::Encoding::Unknown, 0.0};
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < detections; ++i) {
+        detection = EncodingManager::detect(buffer);
+    }
+    double detectUs = timer.nsecsElapsed() / 1e3 / detections;
+
+    // The check a loader runs chunk by chunk when detection is not certain
+    const qint64 chunkBytes = 1024 * 1024;
+    EncodingManager::StreamValidator validator;
+    timer.restart();
+    for (qint64 at = 0; at < buffer.size(); at += chunkBytes) {
+        validator.append(buffer.constData() + at, qMin(chunkBytes, buffer.size() - at));
+    }
+    validator.finish();
+    double validateMs = timer.nsecsElapsed() / 1e6;
+
+    report("encoding-detect", "file_mb", buffer.size() / 1e6, "MB");
+    report("encoding-detect", "detect_us", detectUs, "us");
+    report("encoding-detect", "confidence", detection.confidence, "ratio");
+    report("encoding-detect", "validate_ms", validateMs, "ms");
+    report("encoding-detect", "validate_mb_per_s", buffer.size() / 1e6 / (validateMs / 1e3), "MB/s");
+    if (detection.encoding != EncodingManager::Encoding::UTF8 || validator.encoding() != EncodingManager::Encoding::UTF8) {
+        failure() << "encoding-detect: UTF-8 buffer not detected as UTF-8";
+    }
+}
+
+// The byte-at-a-time checks EncodingManager used before the vector kernels
+bool scalarIsAscii(const QByteArray &data)
+{
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        if ((unsigned char)data[i] > 127) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool scalarIsUtf8(const QByteArray &data)
+{
+    int pending = 0;
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        const unsigned char c = data[i];
+        if (pending > 0) {
+            if ((c & 0xC0) != 0x80) {
+                return false;
+            }
+            --pending;
+        } else if ((c & 0xE0) == 0xC0) {
+            pending = 1;
+        } else if ((c & 0xF0) == 0xE0) {
+            pending = 2;
+        } else if ((c & 0xF8) == 0xF0) {
+            pending = 3;
+        } else if (c > 0x7F) {
+            return false;
+        }
+    }
+    return pending == 0;
+}
+
+// Throughput of the vector ASCII and UTF-8 checks against the scalar loops
+// on 100 MB of ASCII and of mixed UTF-8
+void benchUtf8Validate()
+{
+    const QByteArray asciiLine = "2024-03-01 12:00:01.123 INFO  [worker-3] request completed in 12 ms (status=200)\n";
+    const QByteArray mixedLine = "2024-03-01 12:00:01.123 INFO  [worker-3] caf\xc3\xa9 \xe2\x82\xac" "12 "
+                                 "\xe6\x97\xa5\xe6\x9c\xac \xf0\x9f\x98\x80 done\n";
+    const qint64 targetBytes = 100 * 1024 * 1024;
+    QByteArray ascii;
+    QByteArray mixed;
+    ascii.reserve(targetBytes + asciiLine.size());
+    mixed.reserve(targetBytes + mixedLine.size());
+    while (ascii.size() < targetBytes) {
+        ascii.append(asciiLine);
+    }
+    while (mixed.size() < targetBytes) {
+        mixed.append(mixedLine);
+    }
+
+    bool scalarResult = false;
+    bool vectorResult = false;
+    auto throughput = [](bool (*check)(const QByteArray &), const QByteArray &data, bool *result) {
+        QElapsedTimer timer;
+        timer.start();
+        *result = check(data);
+        return data.size() / 1e6 / (timer.nsecsElapsed() / 1e9);
+    };
+
+    report("utf8-validate", "instruction_set_" + QString::fromLatin1(SimdScan::instructionSet()), 1, "flag");
+    report("utf8-validate", "ascii_scalar_mb_per_s", throughput(scalarIsAscii, ascii, &scalarResult), "MB/s");
+    report("utf8-validate", "ascii_simd_mb_per_s", throughput(EncodingManager::isASCII, ascii, &vectorResult), "MB/s");
+    if (!scalarResult || !vectorResult) {
+        failure() << "utf8-validate: ASCII buffer not found to be ASCII";
+    }
+    report("utf8-validate", "utf8_ascii_scalar_mb_per_s", throughput(scalarIsUtf8, ascii, &scalarResult), "MB/s");
+    report("utf8-validate", "utf8_ascii_simd_mb_per_s", throughput(EncodingManager::isUTF8, ascii, &vectorResult), "MB/s");
+    if (!scalarResult || !vectorResult) {
+        failure() << "utf8-validate: ASCII buffer not found to be UTF-8";
+    }
+    report("utf8-validate", "utf8_mixed_scalar_mb_per_s", throughput(scalarIsUtf8, mixed, &scalarResult), "MB/s");
+    report("utf8-validate", "utf8_mixed_simd_mb_per_s", throughput(EncodingManager::isUTF8, mixed, &vectorResult), "MB/s");
+    if (!scalarResult || !vectorResult || EncodingManager::isASCII(mixed)) {
+        failure() << "utf8-validate: mixed buffer misjudged";
+    }
+
+    // Both checks agree on broken sequences at every offset in a vector,
+    // including the ones the kernels see only by looking back
+    const QList<QByteArray> breaks = {"\xc3", "\xe2\x82", "\xf0\x9f\x98", "\x80", "\xf8", "\xc3\xa9\xa9"};
+    QByteArray sample = mixed.left(4096);
+    for (const QByteArray &broken : breaks) {
+        for (int at = 1000; at < 1000 + 64; ++at) {
+            QByteArray bad = sample;
+            bad.replace(at, broken.size(), broken);
+            if (scalarIsUtf8(bad) != EncodingManager::isUTF8(bad)) {
+                failure() << "utf8-validate: vector and scalar checks disagree at" << at << broken.toHex();
+            }
+        }
+    }
+
+    // Chunk cuts inside sequences carry over the same way
+    EncodingManager::StreamValidator validator;
+    for (qint64 at = 0; at < sample.size(); at += 37) {
+        validator.append(sample.constData() + at, qMin<qint64>(37, sample.size() - at));
+    }
+    validator.finish();
+    if (validator.encoding() != EncodingManager::Encoding::UTF8) {
+        failure() << "utf8-validate: chunked check lost a sequence across a cut";
+    }
+}
+
+// Encoding and decoding ~50 MB of text in every encoding with its own
+// conversion, against Qt's converters where it has one, and round trips
+void benchEncodingTranscode()
+{
+    using Encoding = EncodingManager::Encoding;
+    const QString unicodeLine = QString::fromUtf8("2024-03-01 12:00:01 INFO caf\xc3\xa9 \xe2\x82\xac" "12 "
+                                                  "\xe6\x97\xa5\xe6\x9c\xac \xf0\x9f\x98\x80 done\n");
+    const QString latinLine = QString::fromUtf8("2024-03-01 12:00:01 INFO caf\xc3\xa9 \xc2\xa3" "12 na\xc3\xafve done\n");
+    const qsizetype targetChars = 25 * 1024 * 1024;
+    QString unicodeText;
+    QString latinText;
+    unicodeText.reserve(targetChars + unicodeLine.size());
+    latinText.reserve(targetChars + latinLine.size());
+    while (unicodeText.size() < targetChars) {
+        unicodeText.append(unicodeLine);
+    }
+    while (latinText.size() < targetChars) {
+        latinText.append(latinLine);
+    }
+
+    struct Case {
+        QString name;
+        Encoding encoding;
+        int qtEncoding;  // QStringConverter::Encoding, or -1 for none to compare with
+        const QString *text;
+    };
+    const QList<Case> cases = {
+        {"utf8", Encoding::UTF8, QStringConverter::Utf8, &unicodeText},
+        {"utf16le", Encoding::UTF16LE, QStringConverter::Utf16LE, &unicodeText},
+        {"utf16be", Encoding::UTF16BE, QStringConverter::Utf16BE, &unicodeText},
+        {"utf32le", Encoding::UTF32LE, QStringConverter::Utf32LE, &unicodeText},
+        {"utf32be", Encoding::UTF32BE, QStringConverter::Utf32BE, &unicodeText},
+        {"latin1", Encoding::ISO_8859_1, QStringConverter::Latin1, &latinText},
+        {"windows1252", Encoding::Windows_1252, -1, &latinText},
+    };
+
+    report("encoding-transcode", "instruction_set_" + QString::fromLatin1(SimdScan::instructionSet()), 1, "flag");
+    QElapsedTimer timer;
+    for (const Case &c : cases) {
+        const double megabytes = c.text->size() * 2 / 1e6;  // Of UTF-16 text
+
+        timer.start();
+        const QByteArray bytes = EncodingManager::encode(*c.text, c.encoding, true);
+        report("encoding-transcode", c.name + "_encode_mb_per_s", megabytes / (timer.nsecsElapsed() / 1e9), "MB/s");
+        timer.restart();
+        const QString decoded = EncodingManager::decode(bytes, c.encoding);
+        report("encoding-transcode", c.name + "_decode_mb_per_s", megabytes / (timer.nsecsElapsed() / 1e9), "MB/s");
+        if (decoded != *c.text) {
+            failure() << "encoding-transcode:" << c.name << "round trip changed the text";
+        }
+
+        if (c.qtEncoding < 0) {
+            continue;
+        }
+        QStringEncoder encoder(QStringConverter::Encoding(c.qtEncoding));
+        QStringDecoder decoder(QStringConverter::Encoding(c.qtEncoding));
+        timer.restart();
+        const QByteArray qtBytes = encoder.encode(*c.text);
+        report("encoding-transcode", c.name + "_qt_encode_mb_per_s", megabytes / (timer.nsecsElapsed() / 1e9), "MB/s");
+        timer.restart();
+        const QString qtDecoded = decoder.decode(qtBytes);
+        report("encoding-transcode", c.name + "_qt_decode_mb_per_s", megabytes / (timer.nsecsElapsed() / 1e9), "MB/s");
+        if (qtBytes != bytes || qtDecoded != decoded) {
+            failure() << "encoding-transcode:" << c.name << "differs from Qt's converter";
+        }
+    }
+
+    // Surrogate pairs at every offset across a vector, and the replacement
+    // of unpaired surrogates and code points beyond Unicode
+    const QString emoji = QString::fromUtf8("\xf0\x9f\x98\x80");
+    for (int at = 0; at < 40; ++at) {
+        QString text(40, QLatin1Char('x'));
+        text.insert(at, emoji);
+        for (Encoding encoding : {Encoding::UTF16BE, Encoding::UTF32LE, Encoding::UTF32BE}) {
+            if (EncodingManager::decode(EncodingManager::encode(text, encoding, true), encoding) != text) {
+                failure() << "encoding-transcode: surrogate pair at" << at << "lost in"
+                           << EncodingManager::encodingName(encoding);
+            }
+        }
+    }
+    QString unpaired(40, QLatin1Char('x'));
+    unpaired[20] = QChar(0xD800);
+    QString replaced = unpaired;
+    replaced[20] = QChar::ReplacementCharacter;
+    if (EncodingManager::decode(EncodingManager::encode(unpaired, Encoding::UTF32LE, true), Encoding::UTF32LE) != replaced) {
+        failure() << "encoding-transcode: unpaired surrogate not replaced in UTF-32";
+    }
+    QByteArray beyond(64, '\0');
+    beyond[33] = 0x11; // U+110000 at the ninth code point, big-endian
+    const QString beyondText = EncodingManager::decode(beyond, Encoding::UTF32BE);
+    if (beyondText.size() != 16 || beyondText.at(8) != QChar::ReplacementCharacter) {
+        failure() << "encoding-transcode: code point beyond Unicode not replaced";
+    }
+}
+
+void benchAsyncLoad()
+{
+    const QByteArray logLine = "2024-03-01 12:00:01.123 INFO  [worker-3] request completed in 12 ms (status=200, bytes=5120)\n";
+    const qint64 targetBytes = 30 * 1024 * 1024;
+    QTemporaryFile file;
+    if (!file.open()) {
+        failure() << "async-load: cannot create a temporary file";
+        return;
+    }
+    QByteArray buffer;
+    buffer.reserve(targetBytes + logLine.size());
+    while (buffer.size() < targetBytes) {
+        buffer.append(logLine);
+    }
+    file.write(buffer);
+    file.flush();
+
+    // The old way: everything on the calling thread before the first line shows
+    QElapsedTimer timer;
+    timer.start();
+    {
+        QFile in(file.fileName());
+        in.open(QIODevice::ReadOnly);
+        const QByteArray data = in.readAll();
+        QTextDocument document;
+        document.setPlainText(EncodingManager::decode(data, EncodingManager::detectEncoding(data)));
+    }
+    double syncMs = timer.nsecsElapsed() / 1e6;
+
+    // The loader: time to the first text, and the longest stretch the event
+    // loop spends on one chunk
+    QTextDocument document;
+    FileLoader loader(file.fileName());
+    QEventLoop loop;
+    double firstTextMs = -1;
+    double longestChunkMs = 0;
+    QObject::connect(&loader, &FileLoader::textLoaded, [&](const QString &text, bool replace) {
+        if (firstTextMs < 0) {
+            firstTextMs = timer.nsecsElapsed() / 1e6;
+        }
+        QElapsedTimer chunkTimer;
+        chunkTimer.start();
+        if (replace) {
+            document.setPlainText(text);
+        } else {
+            QTextCursor cursor(&document);
+            cursor.movePosition(QTextCursor::End);
+            cursor.insertText(text);
+        }
+        longestChunkMs = qMax(longestChunkMs, chunkTimer.nsecsElapsed() / 1e6);
+    });
+    QObject::connect(&loader, &FileLoader::finished, &loop, &QEventLoop::quit);
+    timer.restart();
+    loader.start();
+    loop.exec();
+    double asyncMs = timer.nsecsElapsed() / 1e6;
+
+    report("async-load", "file_mb", buffer.size() / 1e6, "MB");
+    report("async-load", "sync_ms", syncMs, "ms");
+    report("async-load", "first_text_ms", firstTextMs, "ms");
+    report("async-load", "longest_chunk_ms", longestChunkMs, "ms");
+    report("async-load", "total_ms", asyncMs, "ms");
+    if (document.characterCount() - 1 != buffer.size()) {
+        failure() << "async-load: loaded text does not match the file";
+    }
+}
+
+struct Benchmark {
+    const char *name;
+    void (*run)();
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+
+    const Benchmark benchmarks[] = {
+        {"language-pack", benchLanguagePack},
+        {"tab-creation", benchTabCreation},
+        {"highlight-cpp", benchHighlightCpp},
+        {"highlight-python", benchHighlightPython},
+        {"comment-scanner", benchCommentScanner},
+        {"lazy-highlight", benchLazyHighlight},
+        {"typing-latency", benchTypingLatency},
+        {"comment-cascade", benchCommentCascade},
+        {"bracket-match", benchBracketMatch},
+        {"fold-all", benchFoldAll},
+        {"gutter-scroll", benchGutterScroll},
+        {"minimap-syntax", benchMinimapSyntax},
+        {"minimap-lod", benchMinimapLod},
+        {"minimap-search", benchMinimapSearch},
+        {"large-file-index", benchLargeFileIndex},
+        {"piece-table-edit", benchPieceTableEdit},
+        {"encoding-detect", benchEncodingDetect},
+        {"async-load", benchAsyncLoad},
+        {"utf8-validate", benchUtf8Validate},
+        {"encoding-transcode", benchEncodingTranscode},
+    };
+
+    QStringList selected = app.arguments().mid(1);
+    for (const Benchmark &benchmark : benchmarks) {
+        if (selected.isEmpty() || selected.contains(QLatin1String(benchmark.name))) {
+            benchmark.run();
+        }
+    }
+
+    return checksFailed ? 1 : 0;
+}
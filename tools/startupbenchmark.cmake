@@ -0,0 +1,32 @@
+# Startup benchmark, run by the startup_benchmark target:
+#   cmake --build <build dir> --target startup_benchmark
+#
+# Starts eddy headless with --profile-startup twice: first with empty
+# settings and no saved session (cold), then again with what the first run
+# left behind (warm). Each run prints one JSON object per startup phase.
+#
+# Expects EDDY (path to the executable) and WORK_DIR (scratch directory).
+
+if(NOT EDDY OR NOT WORK_DIR)
+    message(FATAL_ERROR "Usage: cmake -DEDDY=<eddy> -DWORK_DIR=<dir> -P startupbenchmark.cmake")
+endif()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+# Keep the user's settings and session out of the measurement
+set(ENV{QT_QPA_PLATFORM} offscreen)
+set(ENV{XDG_CONFIG_HOME} "${WORK_DIR}/config")
+set(ENV{XDG_DATA_HOME} "${WORK_DIR}/data")
+
+foreach(run cold warm)
+    execute_process(
+        COMMAND "${EDDY}" --profile-startup=${run}
+        WORKING_DIRECTORY "${WORK_DIR}"
+        RESULT_VARIABLE result
+        TIMEOUT 60
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "eddy --profile-startup=${run} failed: ${result}")
+    endif()
+endforeach()